@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include <DmaBuffer.hpp>
 #include <cores/AxiDma.hpp>
 #include <cores/SimpleTimer.hpp>
@@ -25,6 +27,7 @@
 using CoreList = QVector<AbstractCore*>;
 using BitstreamList = QVector<QString>;
 using MmapList = QVector<QPair<void*, size_t>>;
+using BitstreamCallback = std::function<void(bool, uint64_t)>;
 
 class AbstractCore;
 class IrqThread;
@@ -37,17 +40,26 @@ public:
 
 	virtual bool waitForInterrupt() = 0;
 	virtual void clearInterrupts() = 0;
+	virtual uint16_t interruptSources() const;
 
 	virtual bool loadBitstream(const QString &name) = 0;
+	virtual void loadBitstreamAsync(const QString &name, QObject *context, const BitstreamCallback &callback);
 	virtual const QString &activeBitstream() const = 0;
 	virtual const BitstreamList &bitstreamList() const = 0;
 
+	virtual void *writeCombiningAlias(const void *ptr, size_t size) const;
+	virtual QVector<int> localCpus() const;
+
+	void pinThread() const;
+
 	SimpleTimer *timer() const;
 	AxiDma *dmaEngine() const;
 	const DmaBuffer *dmaBuffer() const;
 	const IrqThread *irqThread() const;
 	const CoreList &coreList() const;
 
+	void takeSnapshot(const CoreList &cores, QByteArray &output) const;
+
 protected:
 	AxiDma *m_dmaEngine = nullptr;
 	DmaBuffer *m_dmaBuffer = nullptr;
@@ -22,6 +22,7 @@
 #include <QHash>
 
 #include <AbstractDevice.hpp>
+#include <CoreCache.hpp>
 
 class AxiDevice : public AbstractDevice
 {
@@ -46,5 +47,6 @@ private:
 	MmapList m_mmapList;
 
 	QString m_activeBitstream;
+	CoreCache m_coreCache;
 	BitstreamList m_bitstreamList;
 };
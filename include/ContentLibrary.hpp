@@ -0,0 +1,61 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+class ContentLibrary
+{
+public:
+	enum EntryType : uint8_t
+	{
+		ENTRY_TEMPLATE,
+		ENTRY_SCRIPT,
+		ENTRY_TYPE_COUNT
+	};
+
+	ContentLibrary(const QString &path);
+	~ContentLibrary();
+
+	bool store(EntryType type, const QString &name, const QByteArray &content, QByteArray &hash);
+	bool query(EntryType type, const QString &name, QByteArray &hash, uint32_t &size);
+	bool load(EntryType type, const QString &name, QByteArray &content);
+	bool remove(EntryType type, const QString &name);
+
+private:
+	struct Entry
+	{
+		QByteArray content;
+		QByteArray hash;
+	};
+
+	static bool isValidName(const QString &name);
+
+	QString filePath(EntryType type, const QString &name) const;
+	const Entry *lookup(EntryType type, const QString &name);
+
+	QString m_path;
+	QMutex m_mutex;
+	QHash<QString, Entry> m_cache[ENTRY_TYPE_COUNT];
+};
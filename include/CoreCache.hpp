@@ -0,0 +1,66 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+struct CoreDescriptor
+{
+	QString name;
+	QString compatible;
+	int offset;
+	int parentOffset;
+	bool hasReg;
+	uint64_t base;
+	uint64_t size;
+};
+
+using CoreDescriptorList = QVector<CoreDescriptor>;
+
+class CoreCache
+{
+	static constexpr char FILE_MAGIC[8] = {'Z', 'B', 'N', 'T', 'C', 'C', 0, 1};
+
+public:
+	CoreCache(const QString &path);
+	~CoreCache();
+
+	const CoreDescriptorList *lookup(const QString &bitstream, const QByteArray &fdt);
+
+private:
+	struct Entry
+	{
+		QByteArray hash;
+		CoreDescriptorList cores;
+	};
+
+	static bool scan(const void *fdt, int offset, CoreDescriptorList &out);
+
+	QString filePath(const QString &bitstream) const;
+	bool readFile(const QString &bitstream, Entry &entry) const;
+	void writeFile(const QString &bitstream, const Entry &entry) const;
+
+	QString m_path;
+	QHash<QString, Entry> m_entries;
+};
@@ -29,8 +29,8 @@
 class DiscoveryServer : public QObject
 {
 public:
-	DiscoveryServer(const QNetworkInterface &iface, quint16 port, bool ip6 = false, QObject *parent = nullptr);
-	DiscoveryServer(const QString &name, QObject *parent = nullptr);
+	DiscoveryServer(const QNetworkInterface &iface, quint16 port, bool ip6 = false, int devices = 1, QObject *parent = nullptr);
+	DiscoveryServer(const QString &name, int devices = 1, QObject *parent = nullptr);
 	~DiscoveryServer();
 
 	void onReadyRead();
@@ -39,6 +39,7 @@ private:
 	bool m_local = false;
 	bool m_ip6 = false;
 	quint16 m_port = 0;
+	int m_devices = 1;
 	QString m_name = "";
 	QNetworkInterface m_iface;
 	QUdpSocket *m_server = nullptr;
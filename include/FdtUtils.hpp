@@ -22,6 +22,7 @@
 #include <functional>
 
 #include <QString>
+#include <QtEndian>
 
 extern "C"
 {
@@ -43,14 +44,7 @@ void appendAsBytes(QByteArray &array, T data)
 template<typename T>
 T readAsNumber(const QByteArray &data, quint32 offset)
 {
-	T res = 0;
-
-	for(uint32_t i = 0; i < sizeof(T); ++i)
-	{
-		res |= T(quint8(data[offset + i])) << (8 * i);
-	}
-
-	return res;
+	return qFromLittleEndian<T>(data.constData() + offset);
 }
 
 extern int64_t getMemoryUsage();
@@ -0,0 +1,76 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include <QMutex>
+#include <QPointer>
+#include <QQueue>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+class AxiMdio;
+
+struct MdioTransaction
+{
+	enum Operation : uint8_t
+	{
+		OP_READ,
+		OP_WRITE
+	};
+
+	Operation op;
+	uint8_t phyAddr;
+	uint8_t devAddr;
+	uint16_t regAddr;
+	uint16_t value;
+};
+
+using MdioBatch = QVector<MdioTransaction>;
+using MdioCallback = std::function<void(bool, const MdioBatch&)>;
+
+class MdioThread : public QThread
+{
+public:
+	MdioThread(AxiMdio *core);
+	~MdioThread();
+
+	void enqueue(const MdioBatch &batch, QObject *context, const MdioCallback &callback);
+	void stop();
+
+private:
+	struct Job
+	{
+		MdioBatch batch;
+		QPointer<QObject> context;
+		MdioCallback callback;
+	};
+
+	void run();
+	void complete(const Job &job, bool ok);
+
+	AxiMdio *m_core;
+
+	QMutex m_mutex;
+	QWaitCondition m_wakeCondition;
+	QQueue<Job> m_queue;
+};
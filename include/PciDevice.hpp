@@ -22,10 +22,13 @@
 #include <QHash>
 
 #include <AbstractDevice.hpp>
+#include <CoreCache.hpp>
 #include <cores/PrController.hpp>
 
 class PciDevice : public AbstractDevice
 {
+	static constexpr int IRQ_VECTORS = 3;
+
 	struct RegionHeader
 	{
 		char magic[5];
@@ -45,19 +48,33 @@ public:
 
 	bool waitForInterrupt();
 	void clearInterrupts();
+	uint16_t interruptSources() const;
 
 	bool loadBitstream(const QString &name);
+	void loadBitstreamAsync(const QString &name, QObject *context, const BitstreamCallback &callback);
 	const QString &activeBitstream() const;
 	const BitstreamList &bitstreamList() const;
 
+	void *writeCombiningAlias(const void *ptr, size_t size) const;
+	QVector<int> localCpus() const;
+
 private:
+	bool setupIrqs(uint32_t index, int count);
+	void closeIrqs();
+	bool loadCores();
+
 	int m_container = -1;
 	int m_group = -1;
 	int m_device = -1;
-	int m_irqfd = -1;
+	QVector<int> m_irqfds;
+	bool m_msix = false;
+	uint16_t m_irqSources = 0;
 
+	QString m_slot;
+	CoreCache m_coreCache;
 	off_t m_confRegion = 0;
 	MmapList m_memMaps;
+	MmapList m_wcMaps;
 	QString m_boardName = "<unknown>";
 
 	PrController *m_prCtl = nullptr;
@@ -0,0 +1,70 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include <QPointer>
+#include <QThread>
+#include <QVector>
+
+#include <ServerMessages.hpp>
+
+class AbstractCore;
+class SimpleTimer;
+
+struct ProfileStep
+{
+	uint64_t time;
+	AbstractCore *core;
+	uint8_t devID;
+	PropertyID propID;
+	QByteArray value;
+};
+
+using ProfileList = QVector<ProfileStep>;
+using ProfileStepCallback = std::function<void(int, uint64_t, uint64_t, bool)>;
+using ProfileDoneCallback = std::function<void(bool)>;
+
+class ProfileThread : public QThread
+{
+	static constexpr uint64_t NS_PER_CYCLE = 8;
+	static constexpr uint64_t SPIN_THRESHOLD = 200'000;
+	static constexpr uint64_t MAX_SLEEP = 10'000'000;
+
+public:
+	ProfileThread(SimpleTimer *timer, const ProfileList &steps, QObject *context,
+	              const ProfileStepCallback &stepCallback, const ProfileDoneCallback &doneCallback);
+	~ProfileThread();
+
+	bool usesCore(uint8_t devID) const;
+	void stop();
+
+private:
+	void run();
+	bool waitUntil(uint64_t time);
+
+	SimpleTimer *m_timer;
+	ProfileList m_steps;
+
+	QPointer<QObject> m_context;
+	ProfileStepCallback m_stepCallback;
+	ProfileDoneCallback m_doneCallback;
+};
@@ -0,0 +1,75 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include <QTimer>
+
+#include <ServerMessages.hpp>
+
+class AbstractCore;
+class StatsCollector;
+
+using RateCallback = std::function<void(uint8_t, uint64_t, uint32_t)>;
+
+class RateController : public QObject
+{
+	static constexpr uint64_t CLOCK_FREQ = 125'000'000;
+	static constexpr uint64_t LINE_RATE = 1'000'000'000;
+	static constexpr uint32_t FRAME_OVERHEAD = 4;
+	static constexpr uint32_t PREAMBLE_SIZE = 8;
+	static constexpr uint32_t MIN_GAP = 12;
+	static constexpr int CONTROL_INTERVAL = 100;
+	static constexpr double CONTROL_GAIN = 0.5;
+
+public:
+	enum Mode : uint8_t
+	{
+		MODE_BITRATE,
+		MODE_LINE_RATE
+	};
+
+	RateController(AbstractCore *generator, StatsCollector *stats, QObject *parent);
+	~RateController();
+
+	bool setTarget(Mode mode, uint64_t target, uint32_t tolerance);
+	void setCallback(const RateCallback &callback);
+
+	uint8_t getGeneratorIndex() const;
+	uint32_t getFrameGap() const;
+
+private:
+	uint32_t readNumber(PropertyID propID) const;
+	void writeGap(double period);
+	void update();
+
+	AbstractCore *m_generator;
+	StatsCollector *m_stats;
+	QTimer *m_timer;
+	RateCallback m_callback;
+
+	double m_target = 0;
+	uint32_t m_tolerance = 0;
+	uint32_t m_gap = MIN_GAP;
+
+	uint64_t m_lastTime = 0;
+	uint64_t m_lastBytes = 0;
+};
@@ -0,0 +1,65 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <Messages.hpp>
+
+// Messages and properties handled only by the server, allocated from 0x4000 onwards
+// so they never collide with the identifiers defined in server-shared
+
+constexpr MessageID MSG_ID_SNAPSHOT = MessageID(0x4000);
+constexpr MessageID MSG_ID_LIBRARY_STORE = MessageID(0x4001);
+constexpr MessageID MSG_ID_LIBRARY_QUERY = MessageID(0x4002);
+constexpr MessageID MSG_ID_LIBRARY_REMOVE = MessageID(0x4003);
+constexpr MessageID MSG_ID_TAGGED_REQUEST = MessageID(0x4004);
+constexpr MessageID MSG_ID_TAGGED_RESPONSE = MessageID(0x4005);
+constexpr MessageID MSG_ID_SUBSCRIBE = MessageID(0x4006);
+constexpr MessageID MSG_ID_PROPERTY_CHANGED = MessageID(0x4007);
+constexpr MessageID MSG_ID_POLLER_CONFIG = MessageID(0x4008);
+constexpr MessageID MSG_ID_COUNTER_RECORD = MessageID(0x4009);
+constexpr MessageID MSG_ID_STAGE_PROPERTY = MessageID(0x400A);
+constexpr MessageID MSG_ID_STAGE_COMMIT = MessageID(0x400B);
+constexpr MessageID MSG_ID_STAGE_CLEAR = MessageID(0x400C);
+constexpr MessageID MSG_ID_RUN_QUEUE = MessageID(0x400D);
+constexpr MessageID MSG_ID_RUN_QUEUE_ITEM = MessageID(0x400E);
+constexpr MessageID MSG_ID_ENGINE_DONE = MessageID(0x400F);
+constexpr MessageID MSG_ID_ENGINE_CANCEL = MessageID(0x4010);
+constexpr MessageID MSG_ID_RFC2544 = MessageID(0x4011);
+constexpr MessageID MSG_ID_RFC2544_TRIAL = MessageID(0x4012);
+constexpr MessageID MSG_ID_RFC2544_RESULT = MessageID(0x4013);
+constexpr MessageID MSG_ID_SWEEP = MessageID(0x4014);
+constexpr MessageID MSG_ID_SWEEP_POINT = MessageID(0x4015);
+constexpr MessageID MSG_ID_PROFILE = MessageID(0x4016);
+constexpr MessageID MSG_ID_PROFILE_STEP = MessageID(0x4017);
+constexpr MessageID MSG_ID_PROFILE_STOP = MessageID(0x4018);
+constexpr MessageID MSG_ID_PROFILE_DONE = MessageID(0x4019);
+constexpr MessageID MSG_ID_RATE_CONTROL = MessageID(0x401A);
+constexpr MessageID MSG_ID_RATE_STATUS = MessageID(0x401B);
+constexpr MessageID MSG_ID_SYNC_START = MessageID(0x401C);
+constexpr MessageID MSG_ID_SYNC_STATUS = MessageID(0x401D);
+constexpr MessageID MSG_ID_BITSTREAM_TIMING = MessageID(0x401E);
+
+constexpr PropertyID PROP_PHY_REG = PropertyID(0x4000);
+constexpr PropertyID PROP_PHY_REG_BULK = PropertyID(0x4001);
+constexpr PropertyID PROP_PHY_DUMP = PropertyID(0x4002);
+constexpr PropertyID PROP_UPLOAD_STATS = PropertyID(0x4003);
+constexpr PropertyID PROP_TEMPLATE_REF = PropertyID(0x4004);
+constexpr PropertyID PROP_SCRIPT_REF = PropertyID(0x4005);
+constexpr PropertyID PROP_BULK = PropertyID(0x4006);
+constexpr PropertyID PROP_PROPERTY_TABLE = PropertyID(0x4007);
@@ -0,0 +1,58 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+
+#include <AbstractDevice.hpp>
+#include <SimThread.hpp>
+
+class SimDevice : public AbstractDevice
+{
+	static constexpr size_t CORE_REGION_SIZE = 0x10000;
+	static constexpr size_t DMA_BUFFER_SIZE = 0x400000;
+	static constexpr int FDT_SIZE = 0x4000;
+
+public:
+	SimDevice(int portCount, uint32_t detectorRate);
+	~SimDevice();
+
+	bool waitForInterrupt();
+	void clearInterrupts();
+
+	bool loadBitstream(const QString &name);
+	const QString &activeBitstream() const;
+	const BitstreamList &bitstreamList() const;
+
+private:
+	QByteArray buildDeviceTree() const;
+	bool enumerateCores(const QByteArray &dtb, SimCoreList &simCores);
+
+	int m_irqfd = -1;
+	int m_portCount;
+	uint32_t m_detectorRate;
+
+	MmapList m_memMaps;
+
+	QMutex m_simMutex;
+	SimThread *m_simThread = nullptr;
+
+	BitstreamList m_bitstreamList;
+};
@@ -0,0 +1,112 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+
+#include <ServerMessages.hpp>
+
+class DmaBuffer;
+
+struct SimCore
+{
+	DeviceType type;
+	volatile void *regs;
+	uint8_t portA;
+	uint8_t portB;
+
+	// Emulation state
+
+	uint64_t nextEvent;
+	uint64_t count;
+	double frames;
+	uint64_t base[4];
+};
+
+using SimCoreList = QVector<SimCore>;
+
+class SimThread : public QThread
+{
+	static constexpr uint64_t CLOCK_FREQ = 125'000'000;
+	static constexpr uint64_t NS_PER_CYCLE = 8;
+	static constexpr uint64_t STEP_INTERVAL = 100;
+	static constexpr uint32_t FRAME_OVERHEAD = 4;
+	static constexpr uint32_t PREAMBLE_SIZE = 8;
+	static constexpr uint32_t BASE_LATENCY = 1000;
+
+	struct PortCounters
+	{
+		uint64_t tx_bytes;
+		uint64_t tx_good;
+		uint64_t rx_bytes;
+		uint64_t rx_good;
+	};
+
+public:
+	SimThread(volatile void *dmaRegs, const DmaBuffer *buffer, int irqfd, const SimCoreList &cores,
+	          int portCount, uint32_t detectorRate);
+	~SimThread();
+
+	void acknowledge();
+	void stop();
+
+private:
+	void run();
+	void step(uint64_t cycles);
+	void resetState();
+
+	void updateTimer(uint64_t cycles, uint64_t &advance);
+	void updateDma();
+	void updateTraffic(SimCore &core, uint64_t advance);
+	void updateStats(SimCore &core, uint64_t advance);
+	void updateLatency(SimCore &core, uint64_t advance);
+	void updateDetector(SimCore &core, uint64_t advance);
+
+	void pushMessage(uint16_t id, const QByteArray &payload);
+	void publish();
+
+	volatile void *m_dmaRegs;
+	volatile void *m_timerRegs = nullptr;
+	const DmaBuffer *m_buffer;
+	int m_irqfd;
+
+	SimCoreList m_cores;
+	QVector<PortCounters> m_ports;
+	uint32_t m_detectorRate;
+
+	QElapsedTimer m_clock;
+	qint64 m_lastStep = 0;
+	uint64_t m_time = 0;
+
+	QByteArray m_payload;
+	QByteArray m_message;
+
+	bool m_dmaEnabled = false;
+	uint32_t m_writePos = 0;
+	uint32_t m_wrapEnd = 0;
+	bool m_wrapped = false;
+	bool m_unpublished = false;
+	std::atomic<bool> m_irqPending;
+};
@@ -0,0 +1,58 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+class ZbntServer;
+
+class SyncCoordinator
+{
+	static constexpr uint64_t NS_PER_CYCLE = 8;
+	static constexpr uint64_t SPIN_THRESHOLD = 200'000;
+	static constexpr uint64_t MAX_SLEEP = 10'000'000;
+	static constexpr uint64_t MAX_DELAY = 10'000'000'000;
+	static constexpr int OFFSET_SAMPLES = 16;
+
+public:
+	SyncCoordinator();
+	~SyncCoordinator();
+
+	void addSession(ZbntServer *session);
+	bool start(ZbntServer *caller, uint64_t releaseTime);
+	void stop();
+
+	static uint64_t hostTime();
+
+private:
+	bool runOn(ZbntServer *caller, ZbntServer *session, bool arm);
+	void release(uint64_t releaseTime);
+	bool waitUntil(uint64_t time);
+	void measureOffsets(uint64_t releaseTime, uint64_t releaseSpread, QByteArray &status) const;
+
+	QMutex m_mutex;
+	bool m_busy = false;
+	QThread *m_thread = nullptr;
+	QVector<ZbntServer*> m_sessions;
+};
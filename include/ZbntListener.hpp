@@ -0,0 +1,62 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QSocketNotifier>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+
+#include <ContentLibrary.hpp>
+#include <SyncCoordinator.hpp>
+#include <ZbntServer.hpp>
+
+class ZbntListener : public QObject
+{
+	static constexpr int MAX_HELLO_SIZE = 256;
+
+	struct PendingConnection
+	{
+		QSocketNotifier *notifier;
+		QTimer *timer;
+		QByteArray data;
+	};
+
+public:
+	ZbntListener(QObject *parent = nullptr);
+	~ZbntListener();
+
+	ZbntServer *session(int idx) const;
+
+protected:
+	void addSession(ZbntServer *session, AbstractDevice *device);
+	int sessionCount() const;
+	void routeConnection(qintptr fd);
+
+private:
+	void onPendingData(qintptr fd);
+	void dropConnection(qintptr fd, bool close);
+
+	QVector<ZbntServer*> m_sessions;
+	QVector<QThread*> m_threads;
+	QHash<qintptr, PendingConnection> m_pending;
+	SyncCoordinator m_sync;
+	ContentLibrary m_library;
+};
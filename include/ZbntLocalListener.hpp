@@ -0,0 +1,39 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include <DiscoveryServer.hpp>
+#include <ZbntListener.hpp>
+
+class ZbntLocalListener : public ZbntListener
+{
+public:
+	ZbntLocalListener(const QString &name, const QVector<AbstractDevice*> &devices);
+	~ZbntLocalListener();
+
+private:
+	void onIncomingConnection();
+
+private:
+	QLocalServer *m_server = nullptr;
+	DiscoveryServer *m_discoveryServer = nullptr;
+};
@@ -18,32 +18,28 @@
 
 #pragma once
 
-#include <QLocalServer>
 #include <QLocalSocket>
 
-#include <DiscoveryServer.hpp>
 #include <ZbntServer.hpp>
 
 class ZbntLocalServer : public ZbntServer
 {
 public:
-	ZbntLocalServer(const QString &name, AbstractDevice *parent);
+	ZbntLocalServer(AbstractDevice *parent);
 	~ZbntLocalServer();
 
+	void acceptClient(qintptr fd, const QByteArray &pending);
+
 private:
 	bool clientAvailable() const;
 	void sendBytes(const QByteArray &data);
 	void sendBytes(const uint8_t *data, int size);
 	void sendMessage(MessageID id, const QByteArray &data);
 
-	void onIncomingConnection();
 	void onReadyRead();
 	void onHelloTimeout();
 	void onNetworkStateChanged(QLocalSocket::LocalSocketState state);
 
 private:
-	QLocalServer *m_server = nullptr;
 	QLocalSocket *m_client = nullptr;
-	DiscoveryServer *m_discoveryServer = nullptr;
 };
-
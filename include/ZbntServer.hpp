@@ -18,21 +18,79 @@
 
 #pragma once
 
+#include <QElapsedTimer>
 #include <QTimer>
 
 #include <AbstractDevice.hpp>
+#include <ContentLibrary.hpp>
 #include <MessageReceiver.hpp>
+#include <ProfileThread.hpp>
+#include <RateController.hpp>
+
+class AbstractEngine;
+class SyncCoordinator;
 
 class ZbntServer : public QObject, public MessageReceiver
 {
+	friend class AbstractEngine;
+	friend class SyncCoordinator;
+
+	static constexpr int RUN_POLL_INTERVAL = 2000;
+	static constexpr int ENGINE_POLL_INTERVAL = 5;
+	static constexpr int RESPONSE_BUFFER_SIZE = 8192;
+	static constexpr int MIN_SUBSCRIPTION_INTERVAL = 10;
+	static constexpr int STOP_POLL_INTERVAL = 10;
+
+	struct Subscription
+	{
+		uint8_t devID;
+		PropertyID propID;
+		QByteArray params;
+		uint16_t interval;
+		qint64 lastSample;
+		QByteArray lastValue;
+	};
+
+	struct DeferredMessage
+	{
+		quint16 id;
+		QByteArray data;
+	};
+
+	struct StagedWrite
+	{
+		uint8_t devID;
+		PropertyID propID;
+		QByteArray value;
+	};
+
 public:
 	ZbntServer(AbstractDevice *parent);
 	~ZbntServer();
 
+	virtual void acceptClient(qintptr fd, const QByteArray &pending) = 0;
+	void setSyncCoordinator(SyncCoordinator *sync);
+	void setContentLibrary(ContentLibrary *library);
+
 protected:
-	void startRun();
+	void startRun(bool stream = true);
 	void stopRun();
 
+	void startEngine(AbstractEngine *engine);
+	void cancelEngine();
+	void onEngineFinished(AbstractEngine *engine, bool completed);
+
+	bool startProfile(const QByteArray &data);
+	void stopProfile(bool completed);
+	bool armSync();
+	void disarmSync();
+	void finishSync(const QByteArray &status);
+	bool setRateControl(const QByteArray &data, uint32_t &gap);
+	void clearRateControl();
+	int findRateController(uint8_t devID) const;
+	bool isRateControlled(uint8_t devID, PropertyID propID, const QByteArray &value) const;
+	void onClientDisconnected();
+
 	virtual bool clientAvailable() const = 0;
 	virtual void sendBytes(const QByteArray &data) = 0;
 	virtual void sendBytes(const uint8_t *data, int size) = 0;
@@ -42,18 +100,72 @@ protected:
 	void onMessageReceived(quint16 id, const QByteArray &data);
 
 private:
+	struct RequestTag
+	{
+		bool valid;
+		uint32_t id;
+	};
+
+	static bool changesRun(quint16 id, const QByteArray &data);
+	void replayDeferred();
+	void dispatchMessage(quint16 id, const QByteArray &data);
+	void handleMessage(quint16 id, const QByteArray &data, const RequestTag &tag);
+	void sendReply(const RequestTag &tag, MessageID id, const QByteArray &data);
+	void finishBitstream(const RequestTag &tag, bool ok, uint64_t switchTime);
+
+	AbstractCore *findCore(uint8_t devID) const;
+	bool applyProperty(AbstractCore *core, PropertyID propID, const QByteArray &value);
+	bool setLibraryProperty(AbstractCore *core, PropertyID propID, const QByteArray &value);
+	bool parseLibraryRequest(const QByteArray &data, ContentLibrary::EntryType &type, QString &name, int &end) const;
 	void handleInterrupt();
 	void pollTimer();
+	void pollSubscriptions();
+	void pollCounters();
+	void commitStaged(QByteArray &response);
+	void updateSubscriptionTimer();
 
 protected:
 	AbstractDevice *m_device = nullptr;
 
 	QTimer *m_helloTimer = nullptr;
 	bool m_helloReceived = false;
+	uint32_t m_session = 0;
 
 private:
 	QTimer *m_runEndTimer = nullptr;
 	bool m_isRunning = false;
+	bool m_streaming = true;
+
+	bool m_loadingBitstream = false;
+	QElapsedTimer m_loadClock;
+	QVector<DeferredMessage> m_deferred;
+
+	bool m_syncArmed = false;
+	bool m_stopAfterSync = false;
+
+	ContentLibrary *m_library = nullptr;
+
+	QTimer *m_subscriptionTimer = nullptr;
+	QElapsedTimer m_subscriptionClock;
+	QVector<Subscription> m_subscriptions;
+
+	QVector<StagedWrite> m_staged;
+
+	AbstractEngine *m_engine = nullptr;
+	uint64_t m_engineSavedLimit = 0;
+
+	ProfileThread *m_profile = nullptr;
+	uint32_t m_profileSerial = 0;
+
+	QVector<RateController*> m_rateControllers;
+	SyncCoordinator *m_sync = nullptr;
+
+	QTimer *m_counterTimer = nullptr;
+	CoreList m_counterCores;
+
+	QByteArray m_response;
+	QByteArray m_value;
+	QByteArray m_tagged;
 
 	QByteArray m_pendingDmaData;
 	uint32_t m_lastDmaIdx = 0;
@@ -18,31 +18,28 @@
 
 #pragma once
 
-#include <QTcpServer>
 #include <QTcpSocket>
 
-#include <DiscoveryServer.hpp>
 #include <ZbntServer.hpp>
 
 class ZbntTcpServer : public ZbntServer
 {
 public:
-	ZbntTcpServer(const QHostAddress &address, quint16 port, AbstractDevice *parent);
+	ZbntTcpServer(AbstractDevice *parent);
 	~ZbntTcpServer();
 
+	void acceptClient(qintptr fd, const QByteArray &pending);
+
 private:
 	bool clientAvailable() const;
 	void sendBytes(const QByteArray &data);
 	void sendBytes(const uint8_t *data, int size);
 	void sendMessage(MessageID id, const QByteArray &data);
 
-	void onIncomingConnection();
 	void onReadyRead();
 	void onHelloTimeout();
 	void onNetworkStateChanged(QAbstractSocket::SocketState state);
 
 private:
-	QTcpServer *m_server = nullptr;
 	QTcpSocket *m_client = nullptr;
-	QVector<DiscoveryServer*> m_discoveryServers;
 };
@@ -0,0 +1,111 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <time.h>
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QTimer>
+#include <QVector>
+
+#include <MessageReceiver.hpp>
+#include <ServerMessages.hpp>
+
+struct BenchConfig
+{
+	int ports;
+	int duration;
+	uint32_t samplePeriod;
+	uint32_t detectorRate;
+	int pipeline;
+	int taggedRequests;
+	int sendDelay;
+	clockid_t serverClock;
+};
+
+using BenchDoneCallback = std::function<void()>;
+
+class BenchClient : public QObject, public MessageReceiver
+{
+	static constexpr uint64_t NS_PER_CYCLE = 8;
+	static constexpr int CONTROL_INTERVAL = 1;
+	static constexpr int MAX_SAMPLES = 4'000'000;
+
+	enum Phase : uint8_t
+	{
+		PHASE_CONNECTING,
+		PHASE_STREAMING,
+		PHASE_DRAINING,
+		PHASE_TAGGED,
+		PHASE_DONE
+	};
+
+public:
+	BenchClient(const BenchConfig &config, const BenchDoneCallback &callback);
+	~BenchClient();
+
+	void start();
+	const QJsonObject &results() const;
+
+private:
+	void onReadyRead();
+	void onMessageReceived(quint16 id, const QByteArray &data);
+
+	void setProperty(uint8_t devID, PropertyID propID, uint64_t value, int size);
+	void startStreaming();
+	void stopStreaming();
+	void sendControlRequest();
+	void sendTaggedRequest();
+	void sendDelayed(MessageID id, const QByteArray &data);
+	void finish();
+
+	static QJsonObject percentiles(QVector<qint64> &samples, double scale);
+
+	BenchConfig m_config;
+	BenchDoneCallback m_callback;
+	Phase m_phase = PHASE_CONNECTING;
+
+	QLocalSocket *m_socket = nullptr;
+	QTimer *m_controlTimer = nullptr;
+	QElapsedTimer m_clock;
+
+	uint64_t m_streamBytes = 0;
+	uint64_t m_messages = 0;
+	qint64 m_firstMessage = -1;
+	qint64 m_lastMessage = -1;
+	double m_cpuStart = 0;
+	double m_cpuEnd = 0;
+	double m_processCpuStart = 0;
+	double m_processCpuEnd = 0;
+
+	QVector<qint64> m_offsets;
+	QVector<qint64> m_controlRtt;
+	qint64 m_controlSent = -1;
+
+	int m_taggedSent = 0;
+	int m_taggedDone = 0;
+	qint64 m_taggedStart = 0;
+	qint64 m_taggedEnd = 0;
+
+	QJsonObject m_results;
+};
@@ -22,8 +22,10 @@
 
 #include <QByteArray>
 #include <QHash>
+#include <QObject>
 
-#include <Messages.hpp>
+#include <ServerMessages.hpp>
+#include <cores/PropertyTable.hpp>
 
 class AbstractCore;
 class AbstractDevice;
@@ -33,6 +35,8 @@ using CoreConstructor = std::function<AbstractCore*(AbstractDevice*, const QStri
 
 using CoreConstructorMap = QHash<QString, CoreConstructor>;
 
+using PropertyCallback = std::function<void(bool, const QByteArray&)>;
+
 class AbstractCore
 {
 public:
@@ -50,13 +54,44 @@ public:
 	virtual uint64_t getPorts() const;
 
 	virtual void setReset(bool reset) = 0;
+	virtual void syncRegisters();
 	virtual bool setProperty(PropertyID propID, const QByteArray &value) = 0;
 	virtual bool getProperty(PropertyID propID, const QByteArray &params, QByteArray &value) = 0;
 
+	virtual bool isAsyncProperty(PropertyID propID) const;
+	virtual void setPropertyAsync(PropertyID propID, const QByteArray &value, QObject *context, const PropertyCallback &callback);
+	virtual void getPropertyAsync(PropertyID propID, const QByteArray &params, QObject *context, const PropertyCallback &callback);
+
+	virtual bool setHold(bool hold);
+	virtual bool getSnapshot(QByteArray &output);
+
+	bool setPropertyBulk(const QByteArray &value);
+	bool getPropertyBulk(const QByteArray &params, QByteArray &value);
+
+protected:
+	template<size_t N>
+	void setPropertyTable(const PropertyDescriptor (&table)[N], volatile void *regs, void *shadow)
+	{
+		m_propTable = table;
+		m_propCount = N;
+		m_propRegs = regs;
+		m_propShadow = shadow;
+	}
+
+	const PropertyDescriptor *findProperty(PropertyID propID) const;
+	bool writeProperty(const PropertyDescriptor &desc, const QByteArray &value);
+	void readProperty(const PropertyDescriptor &desc, QByteArray &value) const;
+	void announceProperties(QByteArray &output, int start) const;
+
 protected:
 	QString m_name;
 	uint32_t m_id;
 
 private:
 	static const CoreConstructorMap coreConstructors;
+
+	const PropertyDescriptor *m_propTable = nullptr;
+	size_t m_propCount = 0;
+	volatile void *m_propRegs = nullptr;
+	void *m_propShadow = nullptr;
 };
@@ -20,6 +20,7 @@
 
 #include <cstdint>
 
+#include <MdioThread.hpp>
 #include <cores/AbstractCore.hpp>
 
 class AxiMdio : public AbstractCore
@@ -30,6 +31,8 @@ public:
 
 	static constexpr uint32_t OP_READ        = 1024;
 
+	static constexpr int64_t TIMEOUT_NS      = 10'000'000;
+
 	struct Registers
 	{
 		uint8_t _padding[0x7e3];
@@ -50,17 +53,30 @@ public:
 
 	DeviceType getType() const;
 
-	uint32_t readPhy(uint32_t phyAddr, uint32_t regAddr);
-	uint32_t readPhyIndirect(uint32_t phyAddr, uint32_t regAddr);
-	void writePhy(uint32_t phyAddr, uint32_t regAddr, uint32_t value);
-	void writePhyIndirect(uint32_t phyAddr, uint32_t regAddr, uint32_t value);
+	bool readPhy(uint32_t phyAddr, uint32_t regAddr, uint16_t &value);
+	bool readPhyIndirect(uint32_t phyAddr, uint32_t devAddr, uint32_t regAddr, uint16_t &value);
+	bool writePhy(uint32_t phyAddr, uint32_t regAddr, uint16_t value);
+	bool writePhyIndirect(uint32_t phyAddr, uint32_t devAddr, uint32_t regAddr, uint16_t value);
+
+	bool execute(MdioBatch &batch);
+	void submit(const MdioBatch &batch, QObject *context, const MdioCallback &callback);
 
 	void setReset(bool reset);
 	bool setProperty(PropertyID propID, const QByteArray &value);
 	bool getProperty(PropertyID propID, const QByteArray &params, QByteArray &value);
 
+	bool isAsyncProperty(PropertyID propID) const;
+	void setPropertyAsync(PropertyID propID, const QByteArray &value, QObject *context, const PropertyCallback &callback);
+	void getPropertyAsync(PropertyID propID, const QByteArray &params, QObject *context, const PropertyCallback &callback);
+
+private:
+	bool waitForIdle();
+	bool parseRegisterList(const QByteArray &data, MdioTransaction::Operation op, MdioBatch &batch) const;
+
 private:
 	volatile Registers *m_regs;
 	QList<uint8_t> m_ports;
 	QList<uint8_t> m_phys;
+
+	MdioThread *m_worker = nullptr;
 };
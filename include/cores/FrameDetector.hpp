@@ -61,13 +61,17 @@ public:
 	uint64_t getPorts() const;
 
 	void setReset(bool reset);
+	void syncRegisters();
 	bool setProperty(PropertyID propID, const QByteArray &value);
 	bool getProperty(PropertyID propID, const QByteArray &params, QByteArray &value);
 
 private:
 	volatile Registers *m_regs;
+	Registers m_shadow;
 	uint8_t m_portA, m_portB;
 
 	QVector<QByteArray> m_scriptNames;
 	QVector<uint32_t> m_scriptSizes;
+	QVector<bool> m_scriptValid;
+	QVector<uint32_t> m_scriptMem;
 };
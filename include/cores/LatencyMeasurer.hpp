@@ -31,6 +31,9 @@ public:
 	static constexpr uint32_t CFG_LOG_ENABLE = 8;
 	static constexpr uint32_t CFG_BROADCAST  = 16;
 
+	static constexpr uint32_t MAX_PADDING = 1500;
+	static constexpr uint32_t MIN_DELAY   = 12;
+
 	struct Registers
 	{
 		uint16_t config;
@@ -54,6 +57,15 @@ public:
 		uint64_t pongs_lost;
 	};
 
+	struct Counters
+	{
+		uint64_t ping_pong_good;
+		uint32_t ping_latency;
+		uint32_t pong_latency;
+		uint64_t pings_lost;
+		uint64_t pongs_lost;
+	};
+
 public:
 	LatencyMeasurer(const QString &name, uint32_t id, void *regs, uint8_t portA, uint8_t portB);
 	~LatencyMeasurer();
@@ -67,10 +79,16 @@ public:
 	uint64_t getPorts() const;
 
 	void setReset(bool reset);
+	void syncRegisters();
 	bool setProperty(PropertyID propID, const QByteArray &value);
 	bool getProperty(PropertyID propID, const QByteArray &params, QByteArray &value);
 
+	bool setHold(bool hold);
+	bool getSnapshot(QByteArray &output);
+	void getCounters(Counters &out) const;
+
 private:
 	volatile Registers *m_regs;
+	Registers m_shadow;
 	uint8_t m_portA, m_portB;
 };
@@ -20,6 +20,8 @@
 
 #include <cstdint>
 
+#include <QElapsedTimer>
+
 #include <AbstractDevice.hpp>
 #include <cores/AbstractCore.hpp>
 
@@ -32,6 +34,16 @@ public:
 
 	static constexpr uint32_t TRIGGER_PENDING = 1u << 31;
 
+	static constexpr int POLL_INTERVAL = 1;
+	static constexpr qint64 START_TIMEOUT = 100'000'000;
+
+	enum LoadState
+	{
+		LOAD_BUSY,
+		LOAD_OK,
+		LOAD_FAILED
+	};
+
 	struct Registers
 	{
 		uint64_t status;
@@ -50,7 +62,10 @@ public:
 	DeviceType getType() const;
 
 	uint32_t status() const;
+	bool startLoad(const QString &name);
+	LoadState pollLoad();
 	bool loadBitstream(const QString &name);
+	uint64_t loadTime() const;
 	int activeBitstream() const;
 	const BitstreamList bitstreamList() const;
 
@@ -61,5 +76,9 @@ public:
 private:
 	volatile Registers *m_regs;
 	BitstreamList m_bitstreamNames;
+
+	QElapsedTimer m_loadClock;
+	bool m_loadSeen = false;
+	uint64_t m_loadTime = 0;
 };
 
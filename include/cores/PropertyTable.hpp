@@ -0,0 +1,57 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ServerMessages.hpp>
+
+// Offset and width of a field of a register block, in the order expected by PropertyDescriptor
+
+#define PROPERTY_REG(regs, field) offsetof(regs, field), sizeof(regs::field)
+
+struct PropertyDescriptor
+{
+	enum Flags : uint8_t
+	{
+		FLAG_READ  = 1,
+		FLAG_WRITE = 2,
+		FLAG_BOOL  = 4,
+		FLAG_LIVE  = 8,
+
+		FLAG_RW = FLAG_READ | FLAG_WRITE
+	};
+
+	PropertyID id;
+	uint16_t offset;
+	uint8_t regWidth;
+	uint8_t wireWidth;
+	uint8_t flags;
+
+	// Bits of the register holding the value, zero for the whole register. Boolean
+	// properties set every bit in the mask when given a non-zero value
+
+	uint64_t mask = 0;
+
+	// Range of values accepted for writes, a maxValue of zero means no upper limit
+
+	uint64_t minValue = 0;
+	uint64_t maxValue = 0;
+};
@@ -28,6 +28,9 @@ public:
 	static constexpr uint32_t CFG_ENABLE = 1;
 	static constexpr uint32_t CFG_RESET  = 2;
 
+	static constexpr int RESET_PULSE = 10;
+	static constexpr qint64 RESET_TIMEOUT = 1'000'000;
+
 	struct Registers
 	{
 		uint32_t config;
@@ -52,6 +55,8 @@ public:
 	void setMaximumTime(uint64_t time);
 
 	void setReset(bool reset);
+	void pulseReset();
+	void syncRegisters();
 	bool setProperty(PropertyID propID, const QByteArray &value);
 	bool getProperty(PropertyID propID, const QByteArray &params, QByteArray &value);
 	uint64_t getCurrentTime() const;
@@ -59,4 +64,5 @@ public:
 
 private:
 	volatile Registers *m_regs;
+	uint64_t m_maxTime;
 };
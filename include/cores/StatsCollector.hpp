@@ -30,6 +30,8 @@ public:
 	static constexpr uint32_t CFG_HOLD       = 4;
 	static constexpr uint32_t CFG_LOG_ENABLE = 8;
 
+	static constexpr uint32_t MIN_SAMPLE_PERIOD = 125;
+
 	struct Registers
 	{
 		uint16_t config;
@@ -46,6 +48,17 @@ public:
 		uint64_t rx_bad;
 	};
 
+	struct Counters
+	{
+		uint64_t time;
+		uint64_t tx_bytes;
+		uint64_t tx_good;
+		uint64_t tx_bad;
+		uint64_t rx_bytes;
+		uint64_t rx_good;
+		uint64_t rx_bad;
+	};
+
 public:
 	StatsCollector(const QString &name, uint32_t id, void *regs, uint8_t port);
 	~StatsCollector();
@@ -59,10 +72,16 @@ public:
 	uint64_t getPorts() const;
 
 	void setReset(bool reset);
+	void syncRegisters();
 	bool setProperty(PropertyID propID, const QByteArray &value);
 	bool getProperty(PropertyID propID, const QByteArray &params, QByteArray &value);
 
+	bool setHold(bool hold);
+	bool getSnapshot(QByteArray &output);
+	void getCounters(Counters &out) const;
+
 private:
 	volatile Registers *m_regs;
+	Registers m_shadow;
 	uint8_t m_port;
 };
@@ -34,6 +34,10 @@ public:
 	static constexpr uint32_t CFG_BURST    = 4;
 	static constexpr uint32_t CFG_SEED_REQ = 8;
 
+	static constexpr uint32_t MIN_FRAME_SIZE = 60;
+	static constexpr uint32_t MAX_FRAME_SIZE = TGEN_MEM_SIZE;
+	static constexpr uint32_t MIN_FRAME_GAP  = 12;
+
 	struct Registers
 	{
 		uint32_t config;
@@ -46,7 +50,7 @@ public:
 	};
 
 public:
-	TrafficGenerator(const QString &name, uint32_t id, void *regs, uint8_t port);
+	TrafficGenerator(const QString &name, uint32_t id, void *regs, void *wcRegs, uint8_t port);
 	~TrafficGenerator();
 
 	static AbstractCore *createCore(AbstractDevice *parent, const QString &name, uint32_t id,
@@ -58,13 +62,21 @@ public:
 	uint64_t getPorts() const;
 
 	void setReset(bool reset);
+	void syncRegisters();
 	bool setProperty(PropertyID propID, const QByteArray &value);
 	bool getProperty(PropertyID propID, const QByteArray &params, QByteArray &value);
 
 private:
 	volatile Registers *m_regs;
+	Registers m_shadow;
+	void *m_wcRegs;
 	uint8_t m_port;
 
 	QByteArray m_templateName;
 	uint32_t m_templateSize;
+	QByteArray m_templateMem;
+	bool m_templateValid = false;
+
+	uint64_t m_uploadTime = 0;
+	uint32_t m_uploadBytes = 0;
 };
@@ -0,0 +1,64 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QObject>
+
+#include <ServerMessages.hpp>
+
+class AbstractCore;
+class AbstractDevice;
+class ZbntServer;
+
+class AbstractEngine : public QObject
+{
+public:
+	enum EngineType : uint8_t
+	{
+		ENGINE_RUN_QUEUE,
+		ENGINE_RFC2544,
+		ENGINE_SWEEP
+	};
+
+	AbstractEngine(ZbntServer *server);
+	virtual ~AbstractEngine();
+
+	virtual bool load(const QByteArray &data) = 0;
+
+	virtual EngineType getType() const = 0;
+	virtual void start() = 0;
+	virtual void onRunStopped() = 0;
+
+protected:
+	bool isActive() const;
+	AbstractDevice *device() const;
+	AbstractCore *findCore(uint8_t devID) const;
+
+	static bool parseProperties(const QByteArray &data, int &offset, QByteArray &list);
+	bool applyProperties(const QByteArray &list);
+
+	void startRun(uint64_t duration, bool stream = true);
+	void sendMessage(MessageID id, const QByteArray &data);
+	void finish();
+
+	ZbntServer *m_server;
+};
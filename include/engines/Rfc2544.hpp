@@ -0,0 +1,88 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QVector>
+
+#include <cores/StatsCollector.hpp>
+#include <engines/AbstractEngine.hpp>
+
+class Rfc2544 : public AbstractEngine
+{
+	static constexpr int DRAIN_TIME = 10;
+
+	struct PortPair
+	{
+		AbstractCore *generator;
+		StatsCollector *txStats;
+		StatsCollector *rxStats;
+
+		StatsCollector::Counters txStart;
+		StatsCollector::Counters rxStart;
+	};
+
+	struct Result
+	{
+		uint16_t frameSize;
+		bool found;
+		uint32_t gap;
+		uint64_t txFrames;
+		uint64_t rxFrames;
+	};
+
+	enum Stage
+	{
+		STAGE_MIN_GAP,
+		STAGE_MAX_GAP,
+		STAGE_SEARCH
+	};
+
+public:
+	Rfc2544(ZbntServer *server);
+	~Rfc2544();
+
+	bool load(const QByteArray &data);
+
+	EngineType getType() const;
+	void start();
+	void onRunStopped();
+
+private:
+	void startSize();
+	void startTrial(uint32_t gap);
+	void evaluateTrial();
+	void finishSize();
+	void setGenerators(bool enable);
+
+	uint64_t m_trialDuration = 0;
+	uint32_t m_tolerance = 0;
+	uint32_t m_minGap = 0;
+	uint32_t m_maxGap = 0;
+	uint32_t m_resolution = 1;
+
+	QVector<PortPair> m_pairs;
+	QVector<uint16_t> m_frameSizes;
+	QVector<Result> m_results;
+
+	int m_sizeIdx = 0;
+	Stage m_stage = STAGE_MIN_GAP;
+	uint32_t m_gap = 0;
+	uint32_t m_lo = 0;
+	uint32_t m_hi = 0;
+};
@@ -0,0 +1,48 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QVector>
+
+#include <engines/AbstractEngine.hpp>
+
+class RunQueue : public AbstractEngine
+{
+	struct Run
+	{
+		uint64_t duration;
+		QByteArray properties;
+	};
+
+public:
+	RunQueue(ZbntServer *server);
+	~RunQueue();
+
+	bool load(const QByteArray &data);
+
+	EngineType getType() const;
+	void start();
+	void onRunStopped();
+
+private:
+	void startNext();
+
+	QVector<Run> m_runs;
+	int m_index = -1;
+};
@@ -0,0 +1,82 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QTimer>
+#include <QVector>
+
+#include <cores/LatencyMeasurer.hpp>
+#include <cores/StatsCollector.hpp>
+#include <engines/AbstractEngine.hpp>
+
+class Sweep : public AbstractEngine
+{
+	static constexpr int MAX_POINTS = 65535;
+	static constexpr int SAMPLE_INTERVAL = 10;
+
+	enum Mode : uint8_t
+	{
+		MODE_CARTESIAN,
+		MODE_LIST
+	};
+
+	struct LatencyStats
+	{
+		LatencyMeasurer *core;
+		LatencyMeasurer::Counters start;
+		uint64_t lastCount;
+		uint32_t min[2];
+		uint32_t max[2];
+		uint64_t sum[2];
+		uint64_t samples;
+	};
+
+	struct TrafficStats
+	{
+		StatsCollector *core;
+		StatsCollector::Counters start;
+	};
+
+public:
+	Sweep(ZbntServer *server);
+	~Sweep();
+
+	bool load(const QByteArray &data);
+
+	EngineType getType() const;
+	void start();
+	void onRunStopped();
+
+private:
+	bool loadCartesian(const QByteArray &data, int offset);
+	bool loadList(const QByteArray &data, int offset);
+
+	void startPoint();
+	void sampleLatency();
+
+	uint64_t m_dwellTime = 0;
+	QVector<QByteArray> m_points;
+
+	QVector<LatencyStats> m_latency;
+	QVector<TrafficStats> m_traffic;
+	QTimer *m_sampleTimer = nullptr;
+
+	int m_index = 0;
+	bool m_applied = false;
+};
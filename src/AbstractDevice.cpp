@@ -18,6 +18,13 @@
 
 #include <AbstractDevice.hpp>
 
+#include <sched.h>
+
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QThread>
+
+#include <FdtUtils.hpp>
 #include <IrqThread.hpp>
 
 AbstractDevice::AbstractDevice()
@@ -50,3 +57,111 @@ const CoreList &AbstractDevice::coreList() const
 {
 	return m_coreList;
 }
+
+uint16_t AbstractDevice::interruptSources() const
+{
+	// Unknown, the DMA engine has to be asked
+
+	return 0;
+}
+
+void *AbstractDevice::writeCombiningAlias(const void *ptr, size_t size) const
+{
+	Q_UNUSED(ptr);
+	Q_UNUSED(size);
+
+	return nullptr;
+}
+
+void AbstractDevice::loadBitstreamAsync(const QString &name, QObject *context, const BitstreamCallback &callback)
+{
+	// Devices that can't poll the reconfiguration run the blocking load in a helper thread,
+	// the callback gets the result and the time taken in us
+
+	QPointer<QObject> target = context;
+
+	QThread *thread = QThread::create(
+		[this, name, target, callback]()
+		{
+			QElapsedTimer clock;
+			clock.start();
+
+			bool ok = loadBitstream(name);
+			uint64_t time = clock.nsecsElapsed() / 1000;
+
+			if(target)
+			{
+				QMetaObject::invokeMethod(target, [callback, ok, time]() { callback(ok, time); }, Qt::QueuedConnection);
+			}
+		}
+	);
+
+	QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+	thread->start();
+}
+
+QVector<int> AbstractDevice::localCpus() const
+{
+	return {};
+}
+
+void AbstractDevice::pinThread() const
+{
+	// Keep the calling thread on the CPUs closest to the device, if the device knows which ones they are
+
+	QVector<int> cpus = localCpus();
+
+	if(cpus.isEmpty())
+	{
+		return;
+	}
+
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+
+	for(int cpu : cpus)
+	{
+		CPU_SET(cpu, &cpuSet);
+	}
+
+	if(sched_setaffinity(0, sizeof(cpuSet), &cpuSet))
+	{
+		qWarning("[dev] W: Can't set CPU affinity for thread");
+	}
+}
+
+void AbstractDevice::takeSnapshot(const CoreList &cores, QByteArray &output) const
+{
+	// Freeze the counters of every core before reading any of them, so all values refer to the same instant
+
+	CoreList heldCores;
+
+	for(AbstractCore *core : cores)
+	{
+		if(core->setHold(true))
+		{
+			heldCores.append(core);
+		}
+	}
+
+	appendAsBytes<uint64_t>(output, m_timer ? m_timer->getCurrentTime() : 0);
+	appendAsBytes<uint8_t>(output, heldCores.size());
+
+	for(AbstractCore *core : heldCores)
+	{
+		int sizeOffset = output.size() + 1;
+
+		appendAsBytes<uint8_t>(output, core->getIndex());
+		appendAsBytes<uint16_t>(output, 0);
+
+		core->getSnapshot(output);
+
+		uint16_t size = output.size() - sizeOffset - 2;
+		memcpy(output.data() + sizeOffset, &size, 2);
+	}
+
+	for(AbstractCore *core : heldCores)
+	{
+		core->setHold(false);
+	}
+}
@@ -24,6 +24,7 @@
 #include <sys/mman.h>
 
 #include <QDirIterator>
+#include <QElapsedTimer>
 
 #include <DmaBuffer.hpp>
 #include <FdtUtils.hpp>
@@ -32,6 +33,7 @@
 #include <cores/SimpleTimer.hpp>
 
 AxiDevice::AxiDevice()
+	: m_coreCache(ZBNT_CACHE_PATH)
 {
 	// Enumerate available bitstreams
 
@@ -107,6 +109,9 @@ bool AxiDevice::loadBitstream(const QString &name)
 {
 	qInfo("[dev] I: Loading bitstream: %s", qUtf8Printable(name));
 
+	QElapsedTimer clock;
+	clock.start();
+
 	// Stop IrqThread
 
 	m_irqThread->requestInterruption();
@@ -190,221 +195,202 @@ bool AxiDevice::loadBitstream(const QString &name)
 
 	m_activeBitstream = name;
 
-	if(!fdtEnumerateDevices(fdt, 0,
-		[&](const QString &name, int offset, int parentOffset) -> bool
+	const CoreDescriptorList *cores = m_coreCache.lookup(name, dtboContents);
+
+	if(!cores)
+	{
+		qCritical("[dev] E: Invalid device tree overlay: %s", qUtf8Printable(dtboPath));
+		return false;
+	}
+
+	for(const CoreDescriptor &desc : *cores)
+	{
+		const QString &name = desc.name;
+		const QString &compatible = desc.compatible;
+		int offset = desc.offset;
+
+		if(compatible == "ikwzm,u-dma-buf")
 		{
-			QString compatible;
+			qInfo("[dmabuf] Found %s, type: %s", qUtf8Printable(name), qUtf8Printable(compatible));
 
-			if(!fdtGetStringProp(fdt, offset, "compatible", compatible))
+			if(m_dmaBuffer)
 			{
-				return true;
+				qCritical("[dmabuf] E: Multiple DMA buffers found");
+				return false;
 			}
 
-			if(compatible == "ikwzm,u-dma-buf")
-			{
-				qInfo("[dmabuf] Found %s, type: %s", qUtf8Printable(name), qUtf8Printable(compatible));
+			// Get properties
 
-				if(m_dmaBuffer)
-				{
-					qCritical("[dmabuf] E: Multiple DMA buffers found");
-					return false;
-				}
+			QString devName;
 
-				// Get properties
+			if(!fdtGetStringProp(fdt, offset, "device-name", devName))
+			{
+				qCritical("[dmabuf] E: Device tree lacks a valid value for device-name");
+				return false;
+			}
 
-				QString devName;
+			size_t size;
 
-				if(!fdtGetStringProp(fdt, offset, "device-name", devName))
-				{
-					qCritical("[dmabuf] E: Device tree lacks a valid value for device-name");
-					return false;
-				}
+			if(!fdtGetArrayProp(fdt, offset, "size", size))
+			{
+				qCritical("[dmabuf] E: Device tree lacks a valid value for size");
+				return false;
+			}
 
-				size_t size;
+			// Get physical address
 
-				if(!fdtGetArrayProp(fdt, offset, "size", size))
-				{
-					qCritical("[dmabuf] E: Device tree lacks a valid value for size");
-					return false;
-				}
+			QString physAddrPath = ZBNT_SYSFS_PATH "/class/u-dma-buf/";
+			physAddrPath.append(devName);
+			physAddrPath.append("/phys_addr");
 
-				// Get physical address
+			QFile physAddrFile(physAddrPath);
 
-				QString physAddrPath = ZBNT_SYSFS_PATH "/class/u-dma-buf/";
-				physAddrPath.append(devName);
-				physAddrPath.append("/phys_addr");
+			if(!physAddrFile.open(QIODevice::ReadOnly))
+			{
+				qCritical("[dmabuf] E: Failed to open %s", qUtf8Printable(physAddrPath));
+				return false;
+			}
 
-				QFile physAddrFile(physAddrPath);
+			bool ok = false;
+			uint64_t physAddr = physAddrFile.readAll().toULongLong(&ok, 16);
 
-				if(!physAddrFile.open(QIODevice::ReadOnly))
-				{
-					qCritical("[dmabuf] E: Failed to open %s", qUtf8Printable(physAddrPath));
-					return false;
-				}
+			if(!ok)
+			{
+				qCritical("[dmabuf] E: Failed to obtain physical address");
+				return false;
+			}
 
-				bool ok = false;
-				uint64_t physAddr = physAddrFile.readAll().toULongLong(&ok, 16);
+			// Open memory map
 
-				if(!ok)
-				{
-					qCritical("[dmabuf] E: Failed to obtain physical address");
-					return false;
-				}
+			QByteArray devPath = "/dev/" + devName.toUtf8();
+			int fd = open(devPath.constData(), O_RDWR);
 
-				// Open memory map
+			if(fd == -1)
+			{
+				qCritical("[dmabuf] E: Failed to open %s", devPath.constData());
+				return false;
+			}
 
-				QByteArray devPath = "/dev/" + devName.toUtf8();
-				int fd = open(devPath.constData(), O_RDWR);
+			void *buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 
-				if(fd == -1)
-				{
-					qCritical("[dmabuf] E: Failed to open %s", devPath.constData());
-					return false;
-				}
+			if(!buf || buf == MAP_FAILED)
+			{
+				qCritical("[dmabuf] E: Failed to mmap %s", devPath.constData());
+				close(fd);
+				return false;
+			}
 
-				void *buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			m_mmapList.append({buf, size});
+			m_dmaBuffer = new DmaBuffer(name, (uint8_t*) buf, physAddr, size);
 
-				if(!buf || buf == MAP_FAILED)
-				{
-					qCritical("[dmabuf] E: Failed to mmap %s", devPath.constData());
-					close(fd);
-					return false;
-				}
+			close(fd);
+		}
+		else if(compatible.startsWith("zbnt,"))
+		{
+			// Find UIO device
 
-				m_mmapList.append({buf, size});
-				m_dmaBuffer = new DmaBuffer(name, (uint8_t*) buf, physAddr, size);
+			uint32_t id = 0;
+			auto it = m_uioMap.constFind(name);
 
-				close(fd);
-			}
-			else if(compatible.startsWith("zbnt,"))
+			if(it == m_uioMap.constEnd())
 			{
-				// Find UIO device
-
-				uint32_t id = 0;
-				auto it = m_uioMap.constFind(name);
-
-				if(it == m_uioMap.constEnd())
-				{
-					return true;
-				}
+				continue;
+			}
 
-				qInfo("[core] Found %s in %s, type: %s", qUtf8Printable(name), it.value().constData(), qUtf8Printable(compatible));
+			qInfo("[core] Found %s in %s, type: %s", qUtf8Printable(name), it.value().constData(), qUtf8Printable(compatible));
 
-				// Generate ID
+			// Generate ID
 
-				if(compatible == "zbnt,message-dma")
+			if(compatible == "zbnt,message-dma")
+			{
+				if(m_dmaEngine)
 				{
-					if(m_dmaEngine)
-					{
-						qCritical("[core] E: Multiple DMA engines found");
-						return false;
-					}
-
-					id = 0x100;
+					qCritical("[core] E: Multiple DMA engines found");
+					return false;
 				}
-				else if(compatible == "zbnt,simple-timer")
-				{
-					if(m_timer)
-					{
-						qCritical("[core] E: Multiple timers found");
-						return false;
-					}
 
-					id = 0xFF;
-				}
-				else
+				id = 0x100;
+			}
+			else if(compatible == "zbnt,simple-timer")
+			{
+				if(m_timer)
 				{
-					id = m_coreList.size();
+					qCritical("[core] E: Multiple timers found");
+					return false;
 				}
 
-				// Get memory range
+				id = 0xFF;
+			}
+			else
+			{
+				id = m_coreList.size();
+			}
 
-				int cellsAddr = fdt_address_cells(fdt, parentOffset);
-				int cellsSize = fdt_size_cells(fdt, parentOffset);
+			// Get memory range
 
-				if(cellsAddr < 0 || cellsSize <= 0)
-				{
-					qCritical("[core] E: Can't determine the number of address and size cells");
-					return false;
-				}
+			if(!desc.hasReg)
+			{
+				qCritical("[core] E: Device tree lacks a valid value for reg");
+				return false;
+			}
 
-				int len = 0;
-				const void *data = fdt_getprop(fdt, offset, "reg", &len);
+			size_t size = desc.size;
 
-				if(!data || len != 4*(cellsAddr + cellsSize))
-				{
-					qCritical("[core] E: Device tree lacks a valid value for reg");
-					return false;
-				}
+			// Open memory map
 
-				size_t size = 0;
+			int fd = open(it.value().constData(), O_RDWR | O_SYNC);
 
-				for(int i = 4*cellsAddr; i < len; ++i)
-				{
-					size = (size << 8) | ((const uint8_t*) data)[i];
-				}
+			if(fd == -1)
+			{
+				qCritical("[core] Failed to open UIO device");
+				return false;
+			}
 
-				// Open memory map
+			void *regs = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 
-				int fd = open(it.value().constData(), O_RDWR | O_SYNC);
+			if(!regs || regs == MAP_FAILED)
+			{
+				qCritical("[core] E: Failed to mmap UIO device");
+				close(fd);
+				return false;
+			}
 
-				if(fd == -1)
-				{
-					qCritical("[core] Failed to open UIO device");
-					return false;
-				}
+			AbstractCore *core = AbstractCore::createCore(this, compatible, name, id, regs, fdt, offset);
 
-				void *regs = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if(!core)
+			{
+				qCritical("[core] E: Failed to create core");
+				munmap(regs, size);
+				close(fd);
+				return false;
+			}
 
-				if(!regs || regs == MAP_FAILED)
+			m_mmapList.append({regs, size});
+
+			switch(core->getType())
+			{
+				case DEV_AXI_DMA:
 				{
-					qCritical("[core] E: Failed to mmap UIO device");
-					close(fd);
-					return false;
+					m_dmaEngine = (AxiDma*) core;
+					m_irqfd = fd;
+					continue;
 				}
 
-				AbstractCore *core = AbstractCore::createCore(this, compatible, name, id, regs, fdt, offset);
-
-				if(!core)
+				case DEV_SIMPLE_TIMER:
 				{
-					qCritical("[core] E: Failed to create core");
-					munmap(regs, size);
-					close(fd);
-					return false;
+					m_timer = (SimpleTimer*) core;
+					break;
 				}
 
-				m_mmapList.append({regs, size});
-
-				switch(core->getType())
+				default:
 				{
-					case DEV_AXI_DMA:
-					{
-						m_dmaEngine = (AxiDma*) core;
-						m_irqfd = fd;
-						return true;
-					}
-
-					case DEV_SIMPLE_TIMER:
-					{
-						m_timer = (SimpleTimer*) core;
-						break;
-					}
-
-					default:
-					{
-						m_coreList.append(core);
-						break;
-					}
+					m_coreList.append(core);
+					break;
 				}
-
-				close(fd);
 			}
 
-			return true;
+			close(fd);
 		}
-	))
-	{
-		return false;
 	}
 
 	if(!m_dmaEngine)
@@ -429,6 +415,8 @@ bool AxiDevice::loadBitstream(const QString &name)
 
 	m_irqThread->start();
 
+	qInfo("[dev] I: Bitstream loaded in %lld us", clock.nsecsElapsed() / 1000);
+
 	return true;
 }
 
@@ -0,0 +1,152 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <ContentLibrary.hpp>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+static const char *entryDirs[ContentLibrary::ENTRY_TYPE_COUNT] = {"templates", "scripts"};
+
+ContentLibrary::ContentLibrary(const QString &path)
+	: m_path(path)
+{ }
+
+ContentLibrary::~ContentLibrary()
+{ }
+
+bool ContentLibrary::store(EntryType type, const QString &name, const QByteArray &content, QByteArray &hash)
+{
+	QMutexLocker lock(&m_mutex);
+
+	if(type >= ENTRY_TYPE_COUNT || !isValidName(name)) return false;
+
+	Entry entry = {content, QCryptographicHash::hash(content, QCryptographicHash::Sha256)};
+	hash = entry.hash;
+
+	// Nothing to do if the same content is already stored under this name
+
+	const Entry *current = lookup(type, name);
+
+	if(current && current->hash == entry.hash)
+	{
+		return true;
+	}
+
+	if(!QDir().mkpath(m_path + "/" + entryDirs[type]))
+	{
+		qWarning("[lib] W: Can't create directory for library entries: %s/%s", qUtf8Printable(m_path), entryDirs[type]);
+		return false;
+	}
+
+	QSaveFile file(filePath(type, name));
+
+	if(!file.open(QIODevice::WriteOnly) || file.write(content) != content.size() || !file.commit())
+	{
+		qWarning("[lib] W: Can't write library entry: %s", qUtf8Printable(file.fileName()));
+		return false;
+	}
+
+	m_cache[type].insert(name, entry);
+
+	qInfo("[lib] I: Stored %s/%s, %d bytes", entryDirs[type], qUtf8Printable(name), content.size());
+	return true;
+}
+
+bool ContentLibrary::query(EntryType type, const QString &name, QByteArray &hash, uint32_t &size)
+{
+	QMutexLocker lock(&m_mutex);
+
+	const Entry *entry = lookup(type, name);
+
+	if(!entry) return false;
+
+	hash = entry->hash;
+	size = entry->content.size();
+	return true;
+}
+
+bool ContentLibrary::load(EntryType type, const QString &name, QByteArray &content)
+{
+	QMutexLocker lock(&m_mutex);
+
+	const Entry *entry = lookup(type, name);
+
+	if(!entry) return false;
+
+	content = entry->content;
+	return true;
+}
+
+bool ContentLibrary::remove(EntryType type, const QString &name)
+{
+	QMutexLocker lock(&m_mutex);
+
+	if(type >= ENTRY_TYPE_COUNT || !isValidName(name)) return false;
+
+	m_cache[type].remove(name);
+
+	if(!QFile::remove(filePath(type, name)))
+	{
+		return false;
+	}
+
+	qInfo("[lib] I: Removed %s/%s", entryDirs[type], qUtf8Printable(name));
+	return true;
+}
+
+bool ContentLibrary::isValidName(const QString &name)
+{
+	if(name.isEmpty() || name.length() > 255) return false;
+	if(name.startsWith('.')) return false;
+
+	return !name.contains('/') && !name.contains('\\') && !name.contains(QChar('\0'));
+}
+
+QString ContentLibrary::filePath(EntryType type, const QString &name) const
+{
+	return m_path + "/" + entryDirs[type] + "/" + name + ".bin";
+}
+
+const ContentLibrary::Entry *ContentLibrary::lookup(EntryType type, const QString &name)
+{
+	if(type >= ENTRY_TYPE_COUNT || !isValidName(name)) return nullptr;
+
+	auto it = m_cache[type].constFind(name);
+
+	if(it != m_cache[type].constEnd())
+	{
+		return &it.value();
+	}
+
+	// Not used since the server started, read it from disk and keep it in memory
+
+	QFile file(filePath(type, name));
+
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		return nullptr;
+	}
+
+	QByteArray content = file.readAll();
+	Entry entry = {content, QCryptographicHash::hash(content, QCryptographicHash::Sha256)};
+
+	return &m_cache[type].insert(name, entry).value();
+}
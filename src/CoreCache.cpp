@@ -0,0 +1,212 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <CoreCache.hpp>
+
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include <FdtUtils.hpp>
+
+constexpr char CoreCache::FILE_MAGIC[8];
+
+CoreCache::CoreCache(const QString &path)
+	: m_path(path)
+{ }
+
+CoreCache::~CoreCache()
+{ }
+
+const CoreDescriptorList *CoreCache::lookup(const QString &bitstream, const QByteArray &fdt)
+{
+	// Descriptors are only reused if they were built from exactly the same device tree, node offsets
+	// stay valid in that case, so the core factories can still read their own properties from it
+
+	QByteArray hash = QCryptographicHash::hash(fdt, QCryptographicHash::Sha256);
+	auto it = m_entries.find(bitstream);
+
+	if(it != m_entries.end() && it->hash == hash)
+	{
+		return &it->cores;
+	}
+
+	Entry entry;
+
+	if(readFile(bitstream, entry) && entry.hash == hash)
+	{
+		return &m_entries.insert(bitstream, entry)->cores;
+	}
+
+	qInfo("[cache] I: Building core descriptors for bitstream %s", qUtf8Printable(bitstream));
+
+	entry.hash = hash;
+	entry.cores.clear();
+
+	if(!scan(fdt.constData(), 0, entry.cores))
+	{
+		return nullptr;
+	}
+
+	writeFile(bitstream, entry);
+
+	return &m_entries.insert(bitstream, entry)->cores;
+}
+
+bool CoreCache::scan(const void *fdt, int offset, CoreDescriptorList &out)
+{
+	for(int node = fdt_first_subnode(fdt, offset); node >= 0; node = fdt_next_subnode(fdt, node))
+	{
+		int len = 0;
+		const char *name = fdt_get_name(fdt, node, &len);
+		const void *compatible = fdt_getprop(fdt, node, "compatible", &len);
+
+		if(compatible)
+		{
+			CoreDescriptor core = {QString::fromUtf8(name), QString::fromUtf8(QByteArray((const char*) compatible, len)), node, offset, false, 0, 0};
+
+			int cellsAddr = fdt_address_cells(fdt, offset);
+			int cellsSize = fdt_size_cells(fdt, offset);
+			const uint8_t *reg = (const uint8_t*) fdt_getprop(fdt, node, "reg", &len);
+
+			if(reg && cellsAddr >= 0 && cellsSize > 0 && len == 4*(cellsAddr + cellsSize))
+			{
+				for(int i = 0; i < 4*cellsAddr; ++i)
+				{
+					core.base = (core.base << 8) | reg[i];
+				}
+
+				for(int i = 4*cellsAddr; i < len; ++i)
+				{
+					core.size = (core.size << 8) | reg[i];
+				}
+
+				core.hasReg = true;
+			}
+
+			out.append(core);
+		}
+
+		if(!scan(fdt, node, out))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+QString CoreCache::filePath(const QString &bitstream) const
+{
+	return m_path + "/" + QString::fromUtf8(bitstream.toUtf8().toHex()) + ".cores";
+}
+
+bool CoreCache::readFile(const QString &bitstream, Entry &entry) const
+{
+	QFile file(filePath(bitstream));
+
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+
+	QByteArray data = file.readAll();
+
+	if(data.size() < 44 || memcmp(data.constData(), FILE_MAGIC, 8))
+	{
+		return false;
+	}
+
+	entry.hash = data.mid(8, 32);
+
+	uint32_t count = readAsNumber<uint32_t>(data, 40);
+	int pos = 44;
+
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		CoreDescriptor core;
+
+		for(QString *str : {&core.name, &core.compatible})
+		{
+			if(pos + 2 > data.size()) return false;
+
+			uint16_t len = readAsNumber<uint16_t>(data, pos);
+			pos += 2;
+
+			if(pos + len > data.size()) return false;
+
+			*str = QString::fromUtf8(data.mid(pos, len));
+			pos += len;
+		}
+
+		if(pos + 25 > data.size()) return false;
+
+		core.offset = readAsNumber<int32_t>(data, pos);
+		core.parentOffset = readAsNumber<int32_t>(data, pos + 4);
+		core.hasReg = readAsNumber<uint8_t>(data, pos + 8);
+		core.base = readAsNumber<uint64_t>(data, pos + 9);
+		core.size = readAsNumber<uint64_t>(data, pos + 17);
+		pos += 25;
+
+		entry.cores.append(core);
+	}
+
+	return true;
+}
+
+void CoreCache::writeFile(const QString &bitstream, const Entry &entry) const
+{
+	QByteArray data(FILE_MAGIC, 8);
+	data.append(entry.hash);
+	appendAsBytes<uint32_t>(data, entry.cores.size());
+
+	for(const CoreDescriptor &core : entry.cores)
+	{
+		for(const QString *str : {&core.name, &core.compatible})
+		{
+			QByteArray strUTF8 = str->toUtf8();
+
+			appendAsBytes<uint16_t>(data, strUTF8.size());
+			data.append(strUTF8);
+		}
+
+		appendAsBytes<int32_t>(data, core.offset);
+		appendAsBytes<int32_t>(data, core.parentOffset);
+		appendAsBytes<uint8_t>(data, core.hasReg);
+		appendAsBytes<uint64_t>(data, core.base);
+		appendAsBytes<uint64_t>(data, core.size);
+	}
+
+	// The cache is only an optimization, failing to write it isn't an error
+
+	if(!QDir().mkpath(m_path))
+	{
+		qWarning("[cache] W: Can't create directory for core cache: %s", qUtf8Printable(m_path));
+		return;
+	}
+
+	QSaveFile file(filePath(bitstream));
+
+	if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+	{
+		qWarning("[cache] W: Can't write core cache for bitstream %s", qUtf8Printable(bitstream));
+	}
+}
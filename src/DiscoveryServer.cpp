@@ -26,8 +26,8 @@
 #include <Version.hpp>
 #include <MessageUtils.hpp>
 
-DiscoveryServer::DiscoveryServer(const QNetworkInterface &iface, quint16 port, bool ip6, QObject *parent)
-	: QObject(parent), m_local(false), m_ip6(ip6), m_port(port), m_name(""), m_iface(iface)
+DiscoveryServer::DiscoveryServer(const QNetworkInterface &iface, quint16 port, bool ip6, int devices, QObject *parent)
+	: QObject(parent), m_local(false), m_ip6(ip6), m_port(port), m_devices(devices), m_name(""), m_iface(iface)
 {
 	m_server = new QUdpSocket(this);
 	connect(m_server, &QUdpSocket::readyRead, this, &DiscoveryServer::onReadyRead);
@@ -67,8 +67,8 @@ DiscoveryServer::DiscoveryServer(const QNetworkInterface &iface, quint16 port, b
 	}
 }
 
-DiscoveryServer::DiscoveryServer(const QString &name, QObject *parent)
-	: QObject(parent), m_local(true), m_ip6(false), m_port(0), m_name(name), m_iface()
+DiscoveryServer::DiscoveryServer(const QString &name, int devices, QObject *parent)
+	: QObject(parent), m_local(true), m_ip6(false), m_port(0), m_devices(devices), m_name(name), m_iface()
 {
 	m_server = new QUdpSocket(this);
 	connect(m_server, &QUdpSocket::readyRead, this, &DiscoveryServer::onReadyRead);
@@ -108,43 +108,54 @@ void DiscoveryServer::onReadyRead()
 
 		request.remove(0, 8);
 
-		QByteArray discoveryResponse, host;
-
-		if(!m_local)
-		{
-			host = QHostInfo::localHostName().toUtf8();
-		}
-		else
+		for(int device = 0; device < m_devices; ++device)
 		{
-			host = m_name.toUtf8();
-		}
+			QByteArray discoveryResponse, host;
 
-		if(host.length() > 255) host.resize(255);
+			if(!m_local)
+			{
+				host = QHostInfo::localHostName().toUtf8();
+			}
+			else
+			{
+				host = m_name.toUtf8();
+			}
 
-		discoveryResponse.append(MSG_MAGIC_IDENTIFIER, 4);
-		appendAsBytes<quint16>(discoveryResponse, MSG_ID_DISCOVERY);
-		appendAsBytes<quint16>(discoveryResponse, 8 + 4 + 16 + 16 + 1 + 1 + 8 + host.length());
+			// Every device gets its own entry, the index is sent in the HELLO message to select it
 
-		discoveryResponse.append(request);
+			if(device != 0)
+			{
+				host.append('#');
+				host.append(QByteArray::number(device));
+			}
 
-		appendAsBytes<quint32>(discoveryResponse, ZBNT_VERSION_INT);
-		discoveryResponse.append(padString(ZBNT_VERSION_PREREL, 16));
-		discoveryResponse.append(padString(ZBNT_VERSION_COMMIT, 16));
-		appendAsBytes<quint8>(discoveryResponse, ZBNT_VERSION_DIRTY);
+			if(host.length() > 255) host.resize(255);
 
-		appendAsBytes<quint8>(discoveryResponse, m_local);
+			discoveryResponse.append(MSG_MAGIC_IDENTIFIER, 4);
+			appendAsBytes<quint16>(discoveryResponse, MSG_ID_DISCOVERY);
+			appendAsBytes<quint16>(discoveryResponse, 8 + 4 + 16 + 16 + 1 + 1 + 8 + host.length());
 
-		if(!m_local)
-		{
-			appendAsBytes<quint64>(discoveryResponse, m_port);
-		}
-		else
-		{
-			appendAsBytes<qint64>(discoveryResponse, QCoreApplication::applicationPid());
-		}
+			discoveryResponse.append(request);
 
-		discoveryResponse.append(host);
+			appendAsBytes<quint32>(discoveryResponse, ZBNT_VERSION_INT);
+			discoveryResponse.append(padString(ZBNT_VERSION_PREREL, 16));
+			discoveryResponse.append(padString(ZBNT_VERSION_COMMIT, 16));
+			appendAsBytes<quint8>(discoveryResponse, ZBNT_VERSION_DIRTY);
 
-		m_server->writeDatagram(datagram.makeReply(discoveryResponse));
+			appendAsBytes<quint8>(discoveryResponse, m_local);
+
+			if(!m_local)
+			{
+				appendAsBytes<quint64>(discoveryResponse, m_port);
+			}
+			else
+			{
+				appendAsBytes<qint64>(discoveryResponse, QCoreApplication::applicationPid());
+			}
+
+			discoveryResponse.append(host);
+
+			m_server->writeDatagram(datagram.makeReply(discoveryResponse));
+		}
 	}
 }
@@ -27,6 +27,8 @@ IrqThread::~IrqThread()
 
 void IrqThread::run()
 {
+	m_device->pinThread();
+
 	while(!isInterruptionRequested())
 	{
 		if(m_device->waitForInterrupt())
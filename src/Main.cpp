@@ -17,6 +17,7 @@
 */
 
 #include <memory>
+#include <vector>
 
 #include <QCoreApplication>
 #include <QFileInfo>
@@ -25,10 +26,11 @@
 
 #include <AxiDevice.hpp>
 #include <PciDevice.hpp>
+#include <SimDevice.hpp>
 #include <CfgUtils.hpp>
 #include <Version.hpp>
-#include <ZbntTcpServer.hpp>
-#include <ZbntLocalServer.hpp>
+#include <ZbntTcpListener.hpp>
+#include <ZbntLocalListener.hpp>
 
 int main(int argc, char **argv)
 {
@@ -65,33 +67,86 @@ int main(int argc, char **argv)
 
 	// Load device-related settings
 
-	std::unique_ptr<AbstractDevice> dev;
+	std::vector<std::unique_ptr<AbstractDevice>> devList;
+	QVector<AbstractDevice*> devices;
 
-#if ZBNT_ZYNQ_MODE
-	dev = std::make_unique<AxiDevice>();
-#else
 	qInfo("[cfg] Loading device settings");
 
 	settings.beginGroup("device");
 
-	QString slot;
-	readSetting(settings, "pci-slot", slot);
-	slot = slot.toLower();
+	QString devType;
+	readSetting(settings, "type", devType, QString("hw"));
+	devType = devType.toLower();
 
-	if(!slot.contains(QRegularExpression("^[0-9a-f]{4}(?:\\:[0-9a-f]{2}){2}\\.[0-9]$")))
+	if(devType == "sim")
+	{
+		int count, ports;
+		uint32_t detectorRate;
+
+		readSetting(settings, "sim-devices", count, 1);
+		readSetting(settings, "sim-ports", ports, 4);
+		readSetting(settings, "sim-detector-rate", detectorRate, uint32_t(1000));
+
+		if(count < 1 || count > 255)
+		{
+			qCritical("[cfg] F: Invalid value for setting: sim-devices");
+			return 1;
+		}
+
+		for(int i = 0; i < count; ++i)
+		{
+			devList.push_back(std::make_unique<SimDevice>(ports, detectorRate));
+		}
+	}
+	else if(devType == "hw")
+	{
+#if ZBNT_ZYNQ_MODE
+		devList.push_back(std::make_unique<AxiDevice>());
+#else
+		QStringList slotList;
+		readSetting(settings, "pci-slot", slotList);
+
+		if(slotList.isEmpty() || slotList.size() > 255)
+		{
+			qCritical("[cfg] F: Invalid value for setting: pci-slot");
+			return 1;
+		}
+
+		for(QString slot : slotList)
+		{
+			slot = slot.trimmed().toLower();
+
+			if(!slot.contains(QRegularExpression("^[0-9a-f]{4}(?:\\:[0-9a-f]{2}){2}\\.[0-9]$")))
+			{
+				qCritical("[cfg] F: Invalid value for setting: pci-slot");
+				return 1;
+			}
+
+			devList.push_back(std::make_unique<PciDevice>(slot));
+		}
+#endif
+	}
+	else
 	{
-		qCritical("[cfg] F: Invalid value for setting: pci-slot");
+		qCritical("[cfg] F: Invalid value for setting: type");
 		return 1;
 	}
 
-	dev = std::make_unique<PciDevice>(slot);
-
 	settings.endGroup();
-#endif
+
+	for(const std::unique_ptr<AbstractDevice> &dev : devList)
+	{
+		devices.append(dev.get());
+	}
+
+	if(devices.size() > 1)
+	{
+		qInfo("[cfg] I: Serving %d devices", devices.size());
+	}
 
 	// Load server-related settings
 
-	std::unique_ptr<ZbntServer> server;
+	std::unique_ptr<ZbntListener> server;
 
 	qInfo("[cfg] Loading server settings");
 
@@ -109,7 +164,7 @@ int main(int argc, char **argv)
 		readSetting(settings, "address", address, QString("::"));
 		readSetting(settings, "port", port, quint16(0));
 
-		server = std::make_unique<ZbntTcpServer>(QHostAddress(address), port, dev.get());
+		server = std::make_unique<ZbntTcpListener>(QHostAddress(address), port, devices);
 	}
 	else if(type == "local")
 	{
@@ -117,7 +172,7 @@ int main(int argc, char **argv)
 
 		readSetting(settings, "name", name);
 
-		server = std::make_unique<ZbntLocalServer>(name, dev.get());
+		server = std::make_unique<ZbntLocalListener>(name, devices);
 	}
 	else
 	{
@@ -0,0 +1,97 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <MdioThread.hpp>
+
+#include <cores/AxiMdio.hpp>
+
+MdioThread::MdioThread(AxiMdio *core)
+	: m_core(core)
+{ }
+
+MdioThread::~MdioThread()
+{
+	stop();
+}
+
+void MdioThread::enqueue(const MdioBatch &batch, QObject *context, const MdioCallback &callback)
+{
+	QMutexLocker lock(&m_mutex);
+
+	m_queue.enqueue({batch, context, callback});
+	m_wakeCondition.wakeOne();
+}
+
+void MdioThread::stop()
+{
+	{
+		QMutexLocker lock(&m_mutex);
+
+		requestInterruption();
+		m_wakeCondition.wakeOne();
+	}
+
+	wait();
+
+	// Anything left in the queue will never reach the PHYs, report it as failed
+
+	while(!m_queue.isEmpty())
+	{
+		complete(m_queue.dequeue(), false);
+	}
+}
+
+void MdioThread::run()
+{
+	while(1)
+	{
+		Job job;
+
+		{
+			QMutexLocker lock(&m_mutex);
+
+			while(m_queue.isEmpty() && !isInterruptionRequested())
+			{
+				m_wakeCondition.wait(&m_mutex);
+			}
+
+			if(isInterruptionRequested())
+			{
+				break;
+			}
+
+			job = m_queue.dequeue();
+		}
+
+		bool ok = m_core->execute(job.batch);
+		complete(job, ok);
+	}
+}
+
+void MdioThread::complete(const Job &job, bool ok)
+{
+	if(!job.callback || !job.context)
+	{
+		return;
+	}
+
+	MdioCallback callback = job.callback;
+	MdioBatch batch = job.batch;
+
+	QMetaObject::invokeMethod(job.context, [callback, ok, batch]() { callback(ok, batch); }, Qt::QueuedConnection);
+}
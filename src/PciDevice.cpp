@@ -20,6 +20,7 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
 #include <sys/eventfd.h>
@@ -27,11 +28,15 @@
 
 #include <QDebug>
 #include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTimer>
 
 #include <FdtUtils.hpp>
 #include <IrqThread.hpp>
 
 PciDevice::PciDevice(const QString &device)
+	: m_slot(device), m_coreCache(ZBNT_CACHE_PATH)
 {
 	// Get IOMMU group for device
 
@@ -118,6 +123,29 @@ PciDevice::PciDevice(const QString &device)
 			qInfo("[dev] I: Found region %u with size %llu KiB", regInfo.index, regInfo.size / 1024);
 
 			m_memMaps.append({ptr, size_t(regInfo.size)});
+
+			// Prefetchable BARs can also be mapped as write-combining through sysfs
+
+			QString wcPath = QString("/sys/bus/pci/devices/%1/resource%2_wc").arg(device).arg(i);
+			int wcFd = open(wcPath.toUtf8().data(), O_RDWR | O_SYNC);
+			void *wcPtr = nullptr;
+
+			if(wcFd != -1)
+			{
+				wcPtr = mmap(NULL, regInfo.size, PROT_READ | PROT_WRITE, MAP_SHARED, wcFd, 0);
+				close(wcFd);
+
+				if(wcPtr == MAP_FAILED)
+				{
+					wcPtr = nullptr;
+				}
+				else
+				{
+					qInfo("[dev] I: Region %u mapped as write-combining", regInfo.index);
+				}
+			}
+
+			m_wcMaps.append({wcPtr, size_t(regInfo.size)});
 		}
 
 		if(i == VFIO_PCI_CONFIG_REGION_INDEX)
@@ -188,29 +216,28 @@ PciDevice::PciDevice(const QString &device)
 
 	m_dmaBuffer = new DmaBuffer("dmabuf0", (uint8_t*) dmaMap.vaddr, dmaMap.iova, dmaMap.size);
 
-	// Setup interrupt handler
+	// Setup interrupt handlers, with one MSI-X vector per DMA interrupt source if the device has them
 
-	uint8_t *setIrqMem = new uint8_t[sizeof(vfio_irq_set) + sizeof(int)];
+	vfio_irq_info irqInfo;
+	irqInfo.argsz = sizeof(irqInfo);
+	irqInfo.index = VFIO_PCI_MSIX_IRQ_INDEX;
 
-	if(!setIrqMem)
+	if(!ioctl(m_device, VFIO_DEVICE_GET_IRQ_INFO, &irqInfo) && irqInfo.count >= IRQ_VECTORS && setupIrqs(VFIO_PCI_MSIX_IRQ_INDEX, IRQ_VECTORS))
 	{
-		qFatal("[dev] Can't allocate vfio_irq_set");
+		m_msix = true;
+		qInfo("[dev] I: Using %d MSI-X vectors", IRQ_VECTORS);
 	}
+	else
+	{
+		closeIrqs();
 
-	vfio_irq_set *setIrq = (vfio_irq_set*) setIrqMem;
-	int *setIrqFd = (int*) (setIrqMem + sizeof(vfio_irq_set));
-
-	setIrq->argsz = sizeof(vfio_irq_set) + sizeof(int);
-	setIrq->flags = VFIO_IRQ_SET_DATA_EVENTFD | VFIO_IRQ_SET_ACTION_TRIGGER;
-	setIrq->index = VFIO_PCI_MSI_IRQ_INDEX;
-	setIrq->start = 0;
-	setIrq->count = 1;
-
-	m_irqfd = eventfd(0, 0);
-	*setIrqFd = m_irqfd;
+		if(!setupIrqs(VFIO_PCI_MSI_IRQ_INDEX, 1))
+		{
+			qCritical("[dev] E: Can't setup MSI interrupt");
+		}
 
-	ioctl(m_device, VFIO_DEVICE_SET_IRQS, setIrq);
-	delete [] setIrqMem;
+		qInfo("[dev] I: Using MSI");
+	}
 
 	// Enumerate devices in static partition
 
@@ -365,11 +392,21 @@ PciDevice::PciDevice(const QString &device)
 
 PciDevice::~PciDevice()
 {
+	closeIrqs();
+
 	for(auto &mm : m_memMaps)
 	{
 		munmap(mm.first, mm.second);
 	}
 
+	for(auto &mm : m_wcMaps)
+	{
+		if(mm.first)
+		{
+			munmap(mm.first, mm.second);
+		}
+	}
+
 	if(m_group != -1)
 	{
 		close(m_group);
@@ -384,12 +421,81 @@ PciDevice::~PciDevice()
 bool PciDevice::waitForInterrupt()
 {
 	uint64_t value;
-	return m_irqfd != -1 && read(m_irqfd, &value, sizeof(value)) == sizeof(value);
+
+	if(!m_msix)
+	{
+		return m_irqfds.size() && read(m_irqfds[0], &value, sizeof(value)) == sizeof(value);
+	}
+
+	// Each vector is tied to a single source, so the status register doesn't need to be read
+
+	pollfd pfds[IRQ_VECTORS];
+
+	for(int i = 0; i < IRQ_VECTORS; ++i)
+	{
+		pfds[i].fd = m_irqfds[i];
+		pfds[i].events = POLLIN;
+	}
+
+	if(poll(pfds, IRQ_VECTORS, -1) < 1)
+	{
+		return false;
+	}
+
+	for(int i = 0; i < IRQ_VECTORS; ++i)
+	{
+		if((pfds[i].revents & POLLIN) && read(m_irqfds[i], &value, sizeof(value)) == sizeof(value))
+		{
+			m_irqSources |= 1u << i;
+		}
+	}
+
+	return m_irqSources != 0;
 }
 
 void PciDevice::clearInterrupts()
 {
-	// no-op
+	m_irqSources = 0;
+}
+
+uint16_t PciDevice::interruptSources() const
+{
+	return m_irqSources;
+}
+
+bool PciDevice::setupIrqs(uint32_t index, int count)
+{
+	QByteArray setIrqMem(sizeof(vfio_irq_set) + count * sizeof(int), 0);
+
+	vfio_irq_set *setIrq = (vfio_irq_set*) setIrqMem.data();
+	int *setIrqFd = (int*) (setIrqMem.data() + sizeof(vfio_irq_set));
+
+	setIrq->argsz = setIrqMem.size();
+	setIrq->flags = VFIO_IRQ_SET_DATA_EVENTFD | VFIO_IRQ_SET_ACTION_TRIGGER;
+	setIrq->index = index;
+	setIrq->start = 0;
+	setIrq->count = count;
+
+	for(int i = 0; i < count; ++i)
+	{
+		m_irqfds.append(eventfd(0, 0));
+		setIrqFd[i] = m_irqfds.last();
+	}
+
+	return !ioctl(m_device, VFIO_DEVICE_SET_IRQS, setIrq);
+}
+
+void PciDevice::closeIrqs()
+{
+	for(int fd : m_irqfds)
+	{
+		if(fd != -1)
+		{
+			close(fd);
+		}
+	}
+
+	m_irqfds.clear();
 }
 
 bool PciDevice::loadBitstream(const QString &name)
@@ -404,6 +510,57 @@ bool PciDevice::loadBitstream(const QString &name)
 		return false;
 	}
 
+	return loadCores();
+}
+
+void PciDevice::loadBitstreamAsync(const QString &name, QObject *context, const BitstreamCallback &callback)
+{
+	qInfo("[dev] I: Loading bitstream: %s", qUtf8Printable(name));
+
+	if(!m_prCtl->startLoad(name))
+	{
+		qCritical("[dev] E: Unknown bitstream: %s", qUtf8Printable(name));
+		QMetaObject::invokeMethod(context, [callback]() { callback(false, 0); }, Qt::QueuedConnection);
+		return;
+	}
+
+	// Poll the PR controller from the event loop of the caller, which stays free in the meantime
+
+	QTimer *pollTimer = new QTimer(context);
+	pollTimer->setInterval(PrController::POLL_INTERVAL);
+
+	QObject::connect(pollTimer, &QTimer::timeout, context,
+		[this, pollTimer, callback]()
+		{
+			PrController::LoadState state = m_prCtl->pollLoad();
+
+			if(state == PrController::LOAD_BUSY)
+			{
+				return;
+			}
+
+			pollTimer->stop();
+			pollTimer->deleteLater();
+
+			if(state == PrController::LOAD_FAILED)
+			{
+				qCritical("[dev] E: PR controller failed with status: 0x%08X", m_prCtl->status());
+				callback(false, m_prCtl->loadTime() / 1000);
+				return;
+			}
+
+			callback(loadCores(), m_prCtl->loadTime() / 1000);
+		}
+	);
+
+	pollTimer->start();
+}
+
+bool PciDevice::loadCores()
+{
+	QElapsedTimer clock;
+	clock.start();
+
 	// Clear devices
 
 	if(m_timer)
@@ -439,102 +596,72 @@ bool PciDevice::loadBitstream(const QString &name)
 	QByteArray dtb(rpHeader.dtb_size, 0);
 	memcpy(dtb.data(), makePointer<void>(m_memMaps[1].first, sizeof(RegionHeader)), rpHeader.dtb_size);
 
-	// Enumerate devices in reconfigurable partition
+	// Enumerate devices in reconfigurable partition, parsing the device tree only the first time it's seen
 
-	int id = 0;
+	const CoreDescriptorList *cores = m_coreCache.lookup(activeBitstream(), dtb);
 	const char *fdt = dtb.constData();
 
-	if(!fdtEnumerateDevices(fdt, 0,
-		[&](const QString &name, int offset, int parentOffset) -> bool
-		{
-			QString compatible;
-
-			if(!fdtGetStringProp(fdt, offset, "compatible", compatible))
-			{
-				return true;
-			}
-
-			if(compatible.startsWith("zbnt,") && compatible != "zbnt,rp_dtb")
-			{
-				qInfo("[core] Found %s in reconfigurable partition, type: %s", qUtf8Printable(name), qUtf8Printable(compatible));
-
-				// Generate ID
-
-				if(compatible == "zbnt,simple-timer")
-				{
-					if(m_timer)
-					{
-						qCritical("[core] E: Multiple timers found");
-						return false;
-					}
-
-					id = 0xFF;
-				}
-				else
-				{
-					id = m_coreList.size();
-				}
-
-				// Get memory range
+	if(!cores)
+	{
+		qCritical("[core] E: Invalid device tree in reconfigurable partition");
+		return false;
+	}
 
-				int cellsAddr = fdt_address_cells(fdt, parentOffset);
-				int cellsSize = fdt_size_cells(fdt, parentOffset);
+	for(const CoreDescriptor &desc : *cores)
+	{
+		if(!desc.compatible.startsWith("zbnt,") || desc.compatible == "zbnt,rp_dtb")
+		{
+			continue;
+		}
 
-				if(cellsAddr < 0 || cellsSize <= 0)
-				{
-					qCritical("[core] E: Can't determine the number of address and size cells");
-					return false;
-				}
+		qInfo("[core] Found %s in reconfigurable partition, type: %s", qUtf8Printable(desc.name), qUtf8Printable(desc.compatible));
 
-				int len = 0;
-				const void *data = fdt_getprop(fdt, offset, "reg", &len);
+		// Generate ID
 
-				if(!data || len != 4*(cellsAddr + cellsSize))
-				{
-					qCritical("[core] E: Device tree lacks a valid value for reg");
-					return false;
-				}
+		int id = 0;
 
-				uintptr_t base = 0;
+		if(desc.compatible == "zbnt,simple-timer")
+		{
+			if(m_timer)
+			{
+				qCritical("[core] E: Multiple timers found");
+				return false;
+			}
 
-				for(int i = 0; i < 4*cellsAddr; ++i)
-				{
-					base = (base << 8) | ((const uint8_t*) data)[i];
-				}
+			id = 0xFF;
+		}
+		else
+		{
+			id = m_coreList.size();
+		}
 
-				size_t size = 0;
+		// Get memory range
 
-				for(int i = 4*cellsAddr; i < len; ++i)
-				{
-					size = (size << 8) | ((const uint8_t*) data)[i];
-				}
+		if(!desc.hasReg)
+		{
+			qCritical("[core] E: Device tree lacks a valid value for reg");
+			return false;
+		}
 
-				// Create core
+		// Create core
 
-				void *regs = makePointer<void>(m_memMaps[1].first, base);
-				AbstractCore *core = AbstractCore::createCore(this, compatible, name, id, regs, fdt, offset);
+		void *regs = makePointer<void>(m_memMaps[1].first, desc.base);
+		AbstractCore *core = AbstractCore::createCore(this, desc.compatible, desc.name, id, regs, fdt, desc.offset);
 
-				if(!core)
-				{
-					qCritical("[core] E: Failed to create core");
-					return false;
-				}
-
-				if(core->getType() == DEV_SIMPLE_TIMER)
-				{
-					m_timer = (SimpleTimer*) core;
-				}
-				else
-				{
-					m_coreList.append(core);
-				}
-			}
+		if(!core)
+		{
+			qCritical("[core] E: Failed to create core");
+			return false;
+		}
 
-			return true;
+		if(core->getType() == DEV_SIMPLE_TIMER)
+		{
+			m_timer = (SimpleTimer*) core;
+		}
+		else
+		{
+			m_coreList.append(core);
 		}
-	))
-	{
-		return false;
 	}
 
 	if(!m_timer)
@@ -543,6 +670,8 @@ bool PciDevice::loadBitstream(const QString &name)
 		return false;
 	}
 
+	qInfo("[dev] I: Cores ready in %lld us", clock.nsecsElapsed() / 1000);
+
 	return true;
 }
 
@@ -555,3 +684,58 @@ const BitstreamList &PciDevice::bitstreamList() const
 {
 	return m_bitstreamList;
 }
+
+void *PciDevice::writeCombiningAlias(const void *ptr, size_t size) const
+{
+	for(int i = 0; i < m_memMaps.size(); ++i)
+	{
+		const uint8_t *base = (const uint8_t*) m_memMaps[i].first;
+		const uint8_t *addr = (const uint8_t*) ptr;
+
+		if(addr >= base && addr + size <= base + m_memMaps[i].second)
+		{
+			if(!m_wcMaps[i].first)
+			{
+				return nullptr;
+			}
+
+			return makePointer<void>(m_wcMaps[i].first, addr - base);
+		}
+	}
+
+	return nullptr;
+}
+
+QVector<int> PciDevice::localCpus() const
+{
+	// The kernel exposes the CPUs attached to the same NUMA node as the card, e.g. "0-3,8-11"
+
+	QFile cpuList("/sys/bus/pci/devices/" + m_slot + "/local_cpulist");
+	QVector<int> cpus;
+
+	if(!cpuList.open(QIODevice::ReadOnly))
+	{
+		return cpus;
+	}
+
+	for(const QByteArray &range : cpuList.readAll().trimmed().split(','))
+	{
+		QList<QByteArray> bounds = range.split('-');
+		bool okFirst = false, okLast = false;
+
+		int first = bounds.first().toInt(&okFirst);
+		int last = bounds.last().toInt(&okLast);
+
+		if(!okFirst || !okLast || bounds.size() > 2)
+		{
+			continue;
+		}
+
+		for(int cpu = first; cpu <= last; ++cpu)
+		{
+			cpus.append(cpu);
+		}
+	}
+
+	return cpus;
+}
@@ -0,0 +1,114 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <ProfileThread.hpp>
+
+#include <time.h>
+
+#include <cores/SimpleTimer.hpp>
+
+ProfileThread::ProfileThread(SimpleTimer *timer, const ProfileList &steps, QObject *context,
+                             const ProfileStepCallback &stepCallback, const ProfileDoneCallback &doneCallback)
+	: m_timer(timer), m_steps(steps), m_context(context), m_stepCallback(stepCallback), m_doneCallback(doneCallback)
+{ }
+
+ProfileThread::~ProfileThread()
+{
+	stop();
+}
+
+bool ProfileThread::usesCore(uint8_t devID) const
+{
+	for(const ProfileStep &step : m_steps)
+	{
+		if(step.devID == devID)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ProfileThread::stop()
+{
+	requestInterruption();
+	wait();
+}
+
+void ProfileThread::run()
+{
+	bool completed = true;
+
+	for(int i = 0; i < m_steps.size(); ++i)
+	{
+		const ProfileStep &step = m_steps[i];
+
+		if(!waitUntil(step.time))
+		{
+			completed = false;
+			break;
+		}
+
+		bool ok = step.core->setProperty(step.propID, step.value);
+		uint64_t actual = m_timer->getCurrentTime();
+
+		if(m_context)
+		{
+			ProfileStepCallback callback = m_stepCallback;
+			uint64_t intended = step.time;
+
+			QMetaObject::invokeMethod(m_context, [callback, i, intended, actual, ok]() { callback(i, intended, actual, ok); }, Qt::QueuedConnection);
+		}
+	}
+
+	if(m_context)
+	{
+		ProfileDoneCallback callback = m_doneCallback;
+
+		QMetaObject::invokeMethod(m_context, [callback, completed]() { callback(completed); }, Qt::QueuedConnection);
+	}
+}
+
+bool ProfileThread::waitUntil(uint64_t time)
+{
+	// Sleep while the step is far away, then spin on the timer for the last stretch. Sleeps are
+	// relative and short, so a timer that is stopped or reset in the meantime is handled correctly
+
+	while(!isInterruptionRequested())
+	{
+		uint64_t now = m_timer->getCurrentTime();
+
+		if(now >= time)
+		{
+			return true;
+		}
+
+		uint64_t remaining = (time - now) * NS_PER_CYCLE;
+
+		if(remaining > SPIN_THRESHOLD)
+		{
+			uint64_t sleepTime = qMin(remaining - SPIN_THRESHOLD, MAX_SLEEP);
+			timespec ts = {time_t(sleepTime / 1'000'000'000), long(sleepTime % 1'000'000'000)};
+
+			clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, nullptr);
+		}
+	}
+
+	return false;
+}
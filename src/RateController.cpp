@@ -0,0 +1,176 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <RateController.hpp>
+
+#include <cstring>
+
+#include <QDebug>
+
+#include <cores/AbstractCore.hpp>
+#include <cores/StatsCollector.hpp>
+#include <FdtUtils.hpp>
+
+RateController::RateController(AbstractCore *generator, StatsCollector *stats, QObject *parent)
+	: QObject(parent), m_generator(generator), m_stats(stats)
+{
+	m_timer = new QTimer(this);
+	m_timer->setInterval(CONTROL_INTERVAL);
+	m_timer->setSingleShot(false);
+
+	connect(m_timer, &QTimer::timeout, this, &RateController::update);
+}
+
+RateController::~RateController()
+{ }
+
+bool RateController::setTarget(Mode mode, uint64_t target, uint32_t tolerance)
+{
+	// Rates are expressed as layer 2 bits per second, the same units counted by tx_bytes
+
+	double frameSize = readNumber(PROP_FRAME_SIZE) + FRAME_OVERHEAD;
+
+	switch(mode)
+	{
+		case MODE_BITRATE:
+		{
+			m_target = target;
+			break;
+		}
+
+		case MODE_LINE_RATE:
+		{
+			m_target = LINE_RATE * (target / 1e6) * frameSize / (frameSize + PREAMBLE_SIZE + MIN_GAP);
+			break;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+
+	if(!m_target) return false;
+
+	m_tolerance = tolerance;
+
+	// Initial estimate, bursts only transmit for a fraction of the time so the rate while active must be higher
+
+	double rate = m_target;
+
+	if(readNumber(PROP_ENABLE_BURST))
+	{
+		double timeOn = readNumber(PROP_BURST_TIME_ON);
+		double timeOff = readNumber(PROP_BURST_TIME_OFF);
+
+		if(timeOn > 0)
+		{
+			rate = rate * (timeOn + timeOff) / timeOn;
+		}
+	}
+
+	writeGap(CLOCK_FREQ * 8 * frameSize / rate);
+
+	StatsCollector::Counters counters;
+	m_stats->getCounters(counters);
+
+	m_lastTime = counters.time;
+	m_lastBytes = counters.tx_bytes;
+	m_timer->start();
+
+	qInfo("[rate] I: Target for core %d set to %.0f bit/s, initial gap: %u", m_generator->getIndex(), m_target, m_gap);
+	return true;
+}
+
+void RateController::setCallback(const RateCallback &callback)
+{
+	m_callback = callback;
+}
+
+uint8_t RateController::getGeneratorIndex() const
+{
+	return m_generator->getIndex();
+}
+
+uint32_t RateController::getFrameGap() const
+{
+	return m_gap;
+}
+
+uint32_t RateController::readNumber(PropertyID propID) const
+{
+	QByteArray value;
+	uint32_t number = 0;
+
+	if(m_generator->getProperty(propID, QByteArray(), value))
+	{
+		memcpy(&number, value.constData(), qMin<int>(value.size(), sizeof(uint32_t)));
+	}
+
+	return number;
+}
+
+void RateController::writeGap(double period)
+{
+	// Period of a frame in clock cycles, one byte is transmitted per cycle
+
+	double frameSize = readNumber(PROP_FRAME_SIZE) + FRAME_OVERHEAD + PREAMBLE_SIZE;
+	double gap = qBound<double>(MIN_GAP, period - frameSize, UINT32_MAX);
+
+	m_gap = gap + 0.5;
+
+	QByteArray value;
+	appendAsBytes<uint32_t>(value, m_gap);
+
+	m_generator->setProperty(PROP_FRAME_GAP, value);
+}
+
+void RateController::update()
+{
+	StatsCollector::Counters counters;
+	m_stats->getCounters(counters);
+
+	// Elapsed time is taken from the timestamp of the counters, so late ticks and a paused timer don't skew
+	// the rate. A new run resets the counters, if they go backwards only resynchronize
+
+	bool valid = counters.time > m_lastTime && counters.tx_bytes >= m_lastBytes;
+	uint64_t cycles = counters.time - m_lastTime;
+	uint64_t bytes = counters.tx_bytes - m_lastBytes;
+
+	m_lastTime = counters.time;
+	m_lastBytes = counters.tx_bytes;
+
+	// Nothing to correct while the timer or the generator are stopped
+
+	if(!valid || !bytes) return;
+
+	double measured = bytes * 8.0 * CLOCK_FREQ / cycles;
+	double error = measured / m_target - 1;
+
+	if(qAbs(error) * 1e6 > m_tolerance)
+	{
+		double frameSize = readNumber(PROP_FRAME_SIZE) + FRAME_OVERHEAD + PREAMBLE_SIZE;
+
+		writeGap((frameSize + m_gap) * (1 + CONTROL_GAIN * error));
+	}
+
+	if(m_callback)
+	{
+		m_callback(m_generator->getIndex(), measured, m_gap);
+	}
+}
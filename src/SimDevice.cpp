@@ -0,0 +1,353 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <SimDevice.hpp>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include <QDebug>
+
+#include <FdtUtils.hpp>
+#include <IrqThread.hpp>
+#include <cores/FrameDetector.hpp>
+
+SimDevice::SimDevice(int portCount, uint32_t detectorRate)
+	: m_portCount(portCount), m_detectorRate(detectorRate)
+{
+	if(portCount < 2 || portCount > 16)
+	{
+		qFatal("[dev] F: Simulated devices must have between 2 and 16 ports");
+	}
+
+	m_bitstreamList.append("sim");
+
+	// Register files, one region for the static partition and another one for the reconfigurable partition
+
+	size_t regionSizes[] = {CORE_REGION_SIZE, CORE_REGION_SIZE * (2 * portCount + 3)};
+
+	for(size_t size : regionSizes)
+	{
+		void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if(ptr == MAP_FAILED)
+		{
+			qFatal("[dev] F: Failed to allocate register file");
+		}
+
+		m_memMaps.append({ptr, size});
+	}
+
+	// Create DMA buffer, the software DMA engine writes to it directly
+
+	void *dmaPtr = mmap(NULL, DMA_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(dmaPtr == MAP_FAILED)
+	{
+		qFatal("[dmabuf] F: Failed to allocate DMA buffer");
+	}
+
+	m_dmaBuffer = new DmaBuffer("dmabuf0", (uint8_t*) dmaPtr, uintptr_t(dmaPtr), DMA_BUFFER_SIZE);
+	m_dmaEngine = (AxiDma*) AbstractCore::createCore(this, "zbnt,message-dma", "dma@0", 0, m_memMaps[0].first, nullptr, 0);
+
+	m_irqfd = eventfd(0, 0);
+
+	if(m_irqfd == -1)
+	{
+		qFatal("[dev] F: Can't create eventfd");
+	}
+
+	qInfo("[dev] I: Running on simulated device with %d ports", portCount);
+
+	if(!loadBitstream(m_bitstreamList[0]))
+	{
+		qFatal("[dev] F: Failed to load initial bitstream");
+	}
+
+	m_irqThread = new IrqThread(this);
+	m_irqThread->start();
+}
+
+SimDevice::~SimDevice()
+{
+	m_irqThread->requestInterruption();
+	m_irqThread->wait();
+
+	delete m_simThread;
+	delete m_timer;
+	delete m_dmaEngine;
+
+	for(const AbstractCore *core : m_coreList)
+	{
+		delete core;
+	}
+
+	for(auto &mm : m_memMaps)
+	{
+		munmap(mm.first, mm.second);
+	}
+
+	munmap(m_dmaBuffer->getVirtualAddr(), m_dmaBuffer->getSize());
+	delete m_dmaBuffer;
+
+	if(m_irqfd != -1)
+	{
+		close(m_irqfd);
+	}
+}
+
+bool SimDevice::waitForInterrupt()
+{
+	uint64_t value;
+
+	pollfd pfd;
+	pfd.fd = m_irqfd;
+	pfd.events = POLLIN;
+
+	return m_irqfd != -1 && poll(&pfd, 1, 100) >= 1 && read(m_irqfd, &value, sizeof(value)) == sizeof(value);
+}
+
+void SimDevice::clearInterrupts()
+{
+	QMutexLocker lock(&m_simMutex);
+
+	if(m_simThread)
+	{
+		m_simThread->acknowledge();
+	}
+}
+
+bool SimDevice::loadBitstream(const QString &name)
+{
+	if(!m_bitstreamList.contains(name))
+	{
+		qCritical("[dev] E: Unknown bitstream: %s", qUtf8Printable(name));
+		return false;
+	}
+
+	qInfo("[dev] I: Loading bitstream: %s", qUtf8Printable(name));
+
+	QMutexLocker lock(&m_simMutex);
+
+	// Clear devices
+
+	delete m_simThread;
+	m_simThread = nullptr;
+
+	if(m_timer)
+	{
+		delete m_timer;
+		m_timer = nullptr;
+	}
+
+	for(const AbstractCore *core : m_coreList)
+	{
+		delete core;
+	}
+
+	m_coreList.clear();
+	memset(m_memMaps[1].first, 0, m_memMaps[1].second);
+
+	// Enumerate devices in reconfigurable partition
+
+	SimCoreList simCores;
+
+	if(!enumerateCores(buildDeviceTree(), simCores))
+	{
+		return false;
+	}
+
+	if(!m_timer)
+	{
+		qCritical("[core] E: No timer found in device tree");
+		return false;
+	}
+
+	m_simThread = new SimThread(m_memMaps[0].first, m_dmaBuffer, m_irqfd, simCores, m_portCount, m_detectorRate);
+	m_simThread->start();
+
+	return true;
+}
+
+const QString &SimDevice::activeBitstream() const
+{
+	return m_bitstreamList[0];
+}
+
+const BitstreamList &SimDevice::bitstreamList() const
+{
+	return m_bitstreamList;
+}
+
+QByteArray SimDevice::buildDeviceTree() const
+{
+	QByteArray dtb(FDT_SIZE, 0);
+	void *fdt = dtb.data();
+	uint32_t base = 0;
+
+	auto addNode = [&](const char *compatible, const QString &name, const QVector<uint32_t> &ports)
+	{
+		QByteArray nodeName = QString("%1@%2").arg(name).arg(base, 0, 16).toUtf8();
+		fdt32_t reg[2] = {cpu_to_fdt32(base), cpu_to_fdt32(CORE_REGION_SIZE)};
+		QVector<fdt32_t> portCells;
+
+		for(uint32_t port : ports)
+		{
+			portCells.append(cpu_to_fdt32(port));
+		}
+
+		fdt_begin_node(fdt, nodeName.constData());
+		fdt_property_string(fdt, "compatible", compatible);
+		fdt_property(fdt, "reg", reg, sizeof(reg));
+
+		if(!portCells.isEmpty())
+		{
+			fdt_property(fdt, "zbnt,ports", portCells.constData(), portCells.size() * sizeof(fdt32_t));
+		}
+
+		fdt_end_node(fdt);
+		base += CORE_REGION_SIZE;
+	};
+
+	fdt_create(fdt, FDT_SIZE);
+	fdt_finish_reservemap(fdt);
+	fdt_begin_node(fdt, "");
+
+	fdt_property_string(fdt, "compatible", "zbnt,sim");
+	fdt_property_u32(fdt, "#address-cells", 1);
+	fdt_property_u32(fdt, "#size-cells", 1);
+
+	addNode("zbnt,simple-timer", "timer", {});
+
+	for(int i = 0; i < m_portCount; ++i)
+	{
+		addNode("zbnt,traffic-generator", QString("tgen%1").arg(i), {uint32_t(i)});
+		addNode("zbnt,stats-collector", QString("stats%1").arg(i), {uint32_t(i)});
+	}
+
+	addNode("zbnt,latency-measurer", "latency0", {0, 1});
+
+	if(m_portCount >= 4)
+	{
+		addNode("zbnt,frame-detector", "detector0", {2, 3});
+	}
+
+	fdt_end_node(fdt);
+	fdt_finish(fdt);
+
+	return dtb;
+}
+
+bool SimDevice::enumerateCores(const QByteArray &dtb, SimCoreList &simCores)
+{
+	int id = 0;
+	const char *fdt = dtb.constData();
+
+	return fdtEnumerateDevices(fdt, 0,
+		[&](const QString &name, int offset, int parentOffset) -> bool
+		{
+			Q_UNUSED(parentOffset);
+
+			QString compatible;
+
+			if(!fdtGetStringProp(fdt, offset, "compatible", compatible))
+			{
+				return true;
+			}
+
+			qInfo("[core] Found %s in simulated device, type: %s", qUtf8Printable(name), qUtf8Printable(compatible));
+
+			// Generate ID
+
+			if(compatible == "zbnt,simple-timer")
+			{
+				if(m_timer)
+				{
+					qCritical("[core] E: Multiple timers found");
+					return false;
+				}
+
+				id = 0xFF;
+			}
+			else
+			{
+				id = m_coreList.size();
+			}
+
+			// Get memory range
+
+			uint32_t base = 0;
+			uint32_t size = 0;
+
+			if(!fdtGetArrayProp(fdt, offset, "reg", base, size) || base + size > m_memMaps[1].second)
+			{
+				qCritical("[core] E: Device tree lacks a valid value for reg");
+				return false;
+			}
+
+			void *regs = makePointer<void>(m_memMaps[1].first, base);
+
+			// Read-only registers normally filled in by the hardware
+
+			if(compatible == "zbnt,frame-detector")
+			{
+				volatile FrameDetector::Registers *fdRegs = (volatile FrameDetector::Registers*) regs;
+
+				fdRegs->features = FrameDetector::HAS_CMP_UNIT | FrameDetector::HAS_EDIT_UNIT | FrameDetector::HAS_CSUM_UNIT;
+				fdRegs->num_scripts = 4;
+				fdRegs->max_script_size = 256;
+				fdRegs->script_mem_offset = 0x2000;
+				fdRegs->tx_fifo_size = 2048;
+				fdRegs->extr_fifo_size = 2048;
+			}
+
+			// Create core
+
+			AbstractCore *core = AbstractCore::createCore(this, compatible, name, id, regs, fdt, offset);
+
+			if(!core)
+			{
+				qCritical("[core] E: Failed to create core");
+				return false;
+			}
+
+			uint8_t portA = 0;
+			uint8_t portB = 0;
+
+			if(!fdtGetArrayProp(fdt, offset, "zbnt,ports", portA, portB))
+			{
+				fdtGetArrayProp(fdt, offset, "zbnt,ports", portA);
+			}
+
+			simCores.append({core->getType(), regs, portA, portB, 0, 0, 0, {}});
+
+			if(core->getType() == DEV_SIMPLE_TIMER)
+			{
+				m_timer = (SimpleTimer*) core;
+			}
+			else
+			{
+				m_coreList.append(core);
+			}
+
+			return true;
+		}
+	);
+}
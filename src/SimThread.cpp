@@ -0,0 +1,465 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <SimThread.hpp>
+
+#include <unistd.h>
+
+#include <DmaBuffer.hpp>
+#include <FdtUtils.hpp>
+#include <cores/AxiDma.hpp>
+#include <cores/FrameDetector.hpp>
+#include <cores/LatencyMeasurer.hpp>
+#include <cores/SimpleTimer.hpp>
+#include <cores/StatsCollector.hpp>
+#include <cores/TrafficGenerator.hpp>
+
+SimThread::SimThread(volatile void *dmaRegs, const DmaBuffer *buffer, int irqfd, const SimCoreList &cores,
+                     int portCount, uint32_t detectorRate)
+	: m_dmaRegs(dmaRegs), m_buffer(buffer), m_irqfd(irqfd), m_cores(cores), m_detectorRate(detectorRate), m_irqPending(false)
+{
+	for(const SimCore &core : m_cores)
+	{
+		if(core.type == DEV_SIMPLE_TIMER)
+		{
+			m_timerRegs = core.regs;
+		}
+	}
+
+	m_ports.fill(PortCounters(), portCount);
+	m_payload.reserve(64);
+	m_message.reserve(64);
+
+	resetState();
+}
+
+SimThread::~SimThread()
+{
+	stop();
+}
+
+void SimThread::acknowledge()
+{
+	// Called once the server has handled the interrupt, the next one can be raised
+
+	if(m_irqPending)
+	{
+		((volatile AxiDma::Registers*) m_dmaRegs)->irq = 0;
+		m_irqPending = false;
+	}
+}
+
+void SimThread::stop()
+{
+	requestInterruption();
+	wait();
+}
+
+void SimThread::run()
+{
+	m_clock.start();
+	m_lastStep = 0;
+
+	while(!isInterruptionRequested())
+	{
+		QThread::usleep(STEP_INTERVAL);
+
+		uint64_t cycles = (m_clock.nsecsElapsed() - m_lastStep) / NS_PER_CYCLE;
+		m_lastStep += cycles * NS_PER_CYCLE;
+
+		step(cycles);
+	}
+}
+
+void SimThread::step(uint64_t cycles)
+{
+	uint64_t advance = 0;
+
+	updateTimer(cycles, advance);
+	updateDma();
+
+	for(SimCore &core : m_cores)
+	{
+		if(core.type == DEV_TRAFFIC_GENERATOR)
+		{
+			updateTraffic(core, advance);
+		}
+	}
+
+	for(SimCore &core : m_cores)
+	{
+		switch(core.type)
+		{
+			case DEV_STATS_COLLECTOR:
+			{
+				updateStats(core, advance);
+				break;
+			}
+
+			case DEV_LATENCY_MEASURER:
+			{
+				updateLatency(core, advance);
+				break;
+			}
+
+			case DEV_FRAME_DETECTOR:
+			{
+				updateDetector(core, advance);
+				break;
+			}
+
+			default:
+			{
+				break;
+			}
+		}
+	}
+
+	publish();
+}
+
+void SimThread::resetState()
+{
+	m_time = 0;
+	m_ports.fill(PortCounters());
+
+	for(SimCore &core : m_cores)
+	{
+		core.nextEvent = 0;
+		core.count = 0;
+		core.frames = 0;
+		memset(core.base, 0, sizeof(core.base));
+	}
+}
+
+void SimThread::updateTimer(uint64_t cycles, uint64_t &advance)
+{
+	if(!m_timerRegs) return;
+
+	volatile SimpleTimer::Registers *regs = (volatile SimpleTimer::Registers*) m_timerRegs;
+
+	if(regs->config & SimpleTimer::CFG_RESET)
+	{
+		regs->current_time = 0;
+		resetState();
+		return;
+	}
+
+	uint64_t current = regs->current_time;
+	uint64_t limit = regs->max_time;
+
+	m_time = current;
+
+	if(!(regs->config & SimpleTimer::CFG_ENABLE) || current >= limit) return;
+
+	advance = qMin(cycles, limit - current);
+	m_time = current + advance;
+	regs->current_time = m_time;
+}
+
+void SimThread::updateDma()
+{
+	volatile AxiDma::Registers *regs = (volatile AxiDma::Registers*) m_dmaRegs;
+	bool enabled = regs->config & AxiDma::CFG_ENABLE;
+
+	if(enabled && !m_dmaEnabled)
+	{
+		// The server expects every transfer to start at the beginning of the buffer
+
+		m_writePos = 0;
+		m_wrapped = false;
+		m_unpublished = false;
+
+		regs->bytes_written = 0;
+		regs->last_msg_end = 0;
+	}
+	else if(!enabled && m_dmaEnabled)
+	{
+		regs->irq = 0;
+	}
+
+	m_dmaEnabled = enabled;
+
+	uint16_t status = enabled ? AxiDma::ST_IO_ACTIVE : 0;
+
+	if(regs->config & AxiDma::CFG_FLUSH_REQ)
+	{
+		status |= AxiDma::ST_FLUSH_ACK;
+	}
+
+	regs->status = status;
+}
+
+void SimThread::updateTraffic(SimCore &core, uint64_t advance)
+{
+	volatile TrafficGenerator::Registers *regs = (volatile TrafficGenerator::Registers*) core.regs;
+	uint32_t config = regs->config;
+
+	if(!advance || !(config & TrafficGenerator::CFG_ENABLE) || (config & TrafficGenerator::CFG_RESET)) return;
+
+	// One byte is transmitted per cycle, bursts only transmit for a fraction of the time
+
+	double frameSize = regs->fsize + FRAME_OVERHEAD;
+	double period = frameSize + PREAMBLE_SIZE + regs->fdelay;
+	double duty = 1;
+
+	if(config & TrafficGenerator::CFG_BURST)
+	{
+		double timeOn = regs->burst_time_on;
+		double timeOff = regs->burst_time_off;
+
+		if(timeOn + timeOff > 0)
+		{
+			duty = timeOn / (timeOn + timeOff);
+		}
+	}
+
+	core.frames += advance * duty / period;
+
+	uint64_t frames = core.frames;
+	core.frames -= frames;
+
+	PortCounters &tx = m_ports[core.portA];
+	tx.tx_bytes += frames * frameSize;
+	tx.tx_good += frames;
+
+	// Ports are looped back in pairs
+
+	int partner = core.portA ^ 1;
+
+	if(partner < m_ports.size())
+	{
+		PortCounters &rx = m_ports[partner];
+		rx.rx_bytes += frames * frameSize;
+		rx.rx_good += frames;
+	}
+}
+
+void SimThread::updateStats(SimCore &core, uint64_t advance)
+{
+	volatile StatsCollector::Registers *regs = (volatile StatsCollector::Registers*) core.regs;
+	const PortCounters &port = m_ports[core.portA];
+	uint16_t config = regs->config;
+
+	if(config & StatsCollector::CFG_RESET)
+	{
+		core.base[0] = port.tx_bytes;
+		core.base[1] = port.tx_good;
+		core.base[2] = port.rx_bytes;
+		core.base[3] = port.rx_good;
+		core.nextEvent = 0;
+
+		regs->time = 0;
+		regs->tx_bytes = regs->tx_good = regs->tx_bad = 0;
+		regs->rx_bytes = regs->rx_good = regs->rx_bad = 0;
+		return;
+	}
+
+	if(!(config & StatsCollector::CFG_ENABLE)) return;
+
+	uint64_t txBytes = port.tx_bytes - core.base[0];
+	uint64_t txGood = port.tx_good - core.base[1];
+	uint64_t rxBytes = port.rx_bytes - core.base[2];
+	uint64_t rxGood = port.rx_good - core.base[3];
+
+	if(!(config & StatsCollector::CFG_HOLD))
+	{
+		regs->time = m_time;
+		regs->tx_bytes = txBytes;
+		regs->tx_good = txGood;
+		regs->rx_bytes = rxBytes;
+		regs->rx_good = rxGood;
+	}
+
+	uint32_t period = regs->sample_period;
+
+	if(!advance || !(config & StatsCollector::CFG_LOG_ENABLE) || !period || m_time < core.nextEvent) return;
+
+	core.nextEvent = (m_time / period + 1) * period;
+
+	m_payload.resize(0);
+	appendAsBytes<uint64_t>(m_payload, m_time);
+	appendAsBytes<uint64_t>(m_payload, txBytes);
+	appendAsBytes<uint64_t>(m_payload, txGood);
+	appendAsBytes<uint64_t>(m_payload, 0);
+	appendAsBytes<uint64_t>(m_payload, rxBytes);
+	appendAsBytes<uint64_t>(m_payload, rxGood);
+	appendAsBytes<uint64_t>(m_payload, 0);
+
+	pushMessage(regs->log_identifier, m_payload);
+}
+
+void SimThread::updateLatency(SimCore &core, uint64_t advance)
+{
+	volatile LatencyMeasurer::Registers *regs = (volatile LatencyMeasurer::Registers*) core.regs;
+	uint16_t config = regs->config;
+
+	if(config & LatencyMeasurer::CFG_RESET)
+	{
+		core.count = 0;
+		core.nextEvent = 0;
+
+		regs->ping_pong_good = 0;
+		regs->ping_latency = regs->pong_latency = 0;
+		regs->pings_lost = regs->pongs_lost = 0;
+		return;
+	}
+
+	uint32_t delay = regs->delay;
+
+	if(!advance || !(config & LatencyMeasurer::CFG_ENABLE) || !delay || m_time < core.nextEvent) return;
+
+	// At most one exchange per step, shorter delays are capped to the step interval
+
+	core.nextEvent = m_time + delay;
+	core.count++;
+
+	uint32_t ping = BASE_LATENCY + regs->padding + (m_time >> 3) % 64;
+	uint32_t pong = BASE_LATENCY + regs->padding + (m_time >> 9) % 64;
+
+	if(!(config & LatencyMeasurer::CFG_HOLD))
+	{
+		regs->ping_pong_good = core.count;
+		regs->ping_latency = ping;
+		regs->pong_latency = pong;
+	}
+
+	if(!(config & LatencyMeasurer::CFG_LOG_ENABLE)) return;
+
+	m_payload.resize(0);
+	appendAsBytes<uint64_t>(m_payload, m_time);
+	appendAsBytes<uint64_t>(m_payload, core.count);
+	appendAsBytes<uint32_t>(m_payload, ping);
+	appendAsBytes<uint32_t>(m_payload, pong);
+	appendAsBytes<uint64_t>(m_payload, 0);
+	appendAsBytes<uint64_t>(m_payload, 0);
+
+	pushMessage(regs->log_identifier, m_payload);
+}
+
+void SimThread::updateDetector(SimCore &core, uint64_t advance)
+{
+	volatile FrameDetector::Registers *regs = (volatile FrameDetector::Registers*) core.regs;
+	uint16_t config = regs->config;
+	uint32_t scripts = regs->script_enable;
+
+	if(!advance || !m_detectorRate || !scripts) return;
+	if(!(config & FrameDetector::CFG_ENABLE) || !(config & FrameDetector::CFG_LOG_ENABLE)) return;
+
+	core.frames += double(advance) * m_detectorRate / CLOCK_FREQ;
+
+	uint64_t matches = core.frames;
+	core.frames -= matches;
+
+	for(uint64_t i = 0; i < matches; ++i)
+	{
+		// Matches rotate through the enabled scripts
+
+		uint32_t script = 0;
+
+		do
+		{
+			script = core.count++ % 32;
+		}
+		while(!(scripts & (1 << script)));
+
+		m_payload.resize(0);
+		appendAsBytes<uint64_t>(m_payload, m_time);
+		appendAsBytes<uint32_t>(m_payload, 1 << script);
+
+		pushMessage(regs->log_identifier, m_payload);
+	}
+}
+
+void SimThread::pushMessage(uint16_t id, const QByteArray &payload)
+{
+	if(!m_dmaEnabled) return;
+
+	uint8_t *buffer = m_buffer->getVirtualAddr();
+	uint32_t bufferSize = m_buffer->getSize();
+
+	m_message.resize(0);
+	m_message.append(MSG_MAGIC_IDENTIFIER, 4);
+	appendAsBytes<uint16_t>(m_message, id);
+	appendAsBytes<uint16_t>(m_message, payload.size());
+	m_message.append(payload);
+
+	uint32_t length = m_message.size();
+
+	if(m_writePos + length < bufferSize)
+	{
+		memcpy(buffer + m_writePos, m_message.constData(), length);
+
+		m_writePos += length;
+		m_unpublished = true;
+		return;
+	}
+
+	// Crossing the end of the buffer, everything written in the current lap must reach the server first
+
+	while(m_wrapped || m_irqPending)
+	{
+		updateDma();
+
+		if(!m_dmaEnabled || isInterruptionRequested()) return;
+
+		publish();
+		QThread::usleep(STEP_INTERVAL / 2);
+	}
+
+	uint32_t first = bufferSize - m_writePos;
+
+	memcpy(buffer + m_writePos, m_message.constData(), first);
+	memcpy(buffer, m_message.constData() + first, length - first);
+
+	m_wrapEnd = length == first ? bufferSize : m_writePos;
+	m_writePos = length - first;
+	m_wrapped = true;
+	m_unpublished = m_writePos != 0;
+}
+
+void SimThread::publish()
+{
+	if(m_irqPending || !m_dmaEnabled) return;
+
+	volatile AxiDma::Registers *regs = (volatile AxiDma::Registers*) m_dmaRegs;
+	uint16_t irq = AxiDma::IRQ_MSG_END;
+
+	if(m_wrapped)
+	{
+		regs->last_msg_end = m_wrapEnd;
+		irq |= AxiDma::IRQ_MEM_END;
+		m_wrapped = false;
+	}
+	else if(m_unpublished)
+	{
+		regs->last_msg_end = m_writePos;
+		m_unpublished = false;
+	}
+	else
+	{
+		return;
+	}
+
+	regs->bytes_written = m_writePos;
+	regs->irq = irq;
+	m_irqPending = true;
+
+	uint64_t value = 1;
+	write(m_irqfd, &value, sizeof(value));
+}
@@ -0,0 +1,263 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <SyncCoordinator.hpp>
+
+#include <time.h>
+
+#include <QThread>
+
+#include <MessageUtils.hpp>
+#include <ServerMessages.hpp>
+#include <ZbntServer.hpp>
+
+SyncCoordinator::SyncCoordinator()
+{ }
+
+SyncCoordinator::~SyncCoordinator()
+{
+	stop();
+	delete m_thread;
+}
+
+void SyncCoordinator::addSession(ZbntServer *session)
+{
+	m_sessions.append(session);
+}
+
+bool SyncCoordinator::start(ZbntServer *caller, uint64_t releaseTime)
+{
+	// Only one synchronized start at a time, a second request fails instead of waiting on the other
+	// session, which could itself be waiting for this one
+
+	{
+		QMutexLocker lock(&m_mutex);
+
+		if(m_busy)
+		{
+			return false;
+		}
+
+		m_busy = true;
+	}
+
+	uint64_t now = hostTime();
+
+	if(releaseTime && (releaseTime < now || releaseTime - now > MAX_DELAY))
+	{
+		QMutexLocker lock(&m_mutex);
+		m_busy = false;
+		return false;
+	}
+
+	// Arm every device: DMA running and session state updated, but timers still stopped. Armed sessions
+	// keep serving clients, but hold back anything that could stop the run or replace the timer
+
+	int armed = 0;
+
+	for(; armed < m_sessions.size(); ++armed)
+	{
+		if(!runOn(caller, m_sessions[armed], true))
+		{
+			break;
+		}
+	}
+
+	if(armed != m_sessions.size())
+	{
+		qWarning("[sync] W: Can't arm device %d, synchronized start cancelled", armed);
+
+		while(armed--)
+		{
+			runOn(caller, m_sessions[armed], false);
+		}
+
+		QMutexLocker lock(&m_mutex);
+		m_busy = false;
+		return false;
+	}
+
+	// Wait and release from a separate thread, so the sessions stay responsive in the meantime
+
+	QMutexLocker lock(&m_mutex);
+
+	if(m_thread)
+	{
+		m_thread->wait();
+		delete m_thread;
+	}
+
+	m_thread = QThread::create([this, releaseTime]() { release(releaseTime); });
+	m_thread->start();
+
+	return true;
+}
+
+void SyncCoordinator::stop()
+{
+	// The release thread takes the lock on its way out, so don't hold it while waiting
+
+	QThread *thread = nullptr;
+
+	{
+		QMutexLocker lock(&m_mutex);
+		thread = m_thread;
+	}
+
+	if(thread)
+	{
+		thread->requestInterruption();
+		thread->wait();
+	}
+}
+
+uint64_t SyncCoordinator::hostTime()
+{
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return uint64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+bool SyncCoordinator::runOn(ZbntServer *caller, ZbntServer *session, bool arm)
+{
+	// Session state belongs to the session thread, the caller's own session is already running in it
+
+	bool ok = false;
+	auto func = [session, arm, &ok]()
+	{
+		if(arm)
+		{
+			ok = session->armSync();
+		}
+		else
+		{
+			session->disarmSync();
+			ok = true;
+		}
+	};
+
+	if(session == caller || session->thread() == QThread::currentThread())
+	{
+		func();
+	}
+	else
+	{
+		QMetaObject::invokeMethod(session, func, Qt::BlockingQueuedConnection);
+	}
+
+	return ok;
+}
+
+void SyncCoordinator::release(uint64_t releaseTime)
+{
+	QByteArray status;
+
+	if(waitUntil(releaseTime))
+	{
+		// Release all the timers back to back
+
+		uint64_t releaseStart = hostTime();
+
+		for(ZbntServer *session : m_sessions)
+		{
+			session->m_device->timer()->setRunning(true);
+		}
+
+		uint64_t releaseEnd = hostTime();
+
+		measureOffsets(releaseStart, releaseEnd - releaseStart, status);
+
+		qInfo("[sync] I: Released %d devices in %llu ns", m_sessions.size(), (unsigned long long) (releaseEnd - releaseStart));
+	}
+	else
+	{
+		qWarning("[sync] W: Synchronized start aborted");
+	}
+
+	for(ZbntServer *session : m_sessions)
+	{
+		QMetaObject::invokeMethod(session, [session, status]() { session->finishSync(status); }, Qt::QueuedConnection);
+	}
+
+	QMutexLocker lock(&m_mutex);
+	m_busy = false;
+}
+
+bool SyncCoordinator::waitUntil(uint64_t time)
+{
+	// Sleep while the release is far away, then spin for the last stretch
+
+	uint64_t now;
+
+	while((now = hostTime()) < time)
+	{
+		if(QThread::currentThread()->isInterruptionRequested())
+		{
+			return false;
+		}
+
+		uint64_t remaining = time - now;
+
+		if(remaining > SPIN_THRESHOLD)
+		{
+			uint64_t sleepTime = qMin(remaining - SPIN_THRESHOLD, MAX_SLEEP);
+			timespec ts = {time_t(sleepTime / 1'000'000'000), long(sleepTime % 1'000'000'000)};
+
+			clock_nanosleep(CLOCK_REALTIME, 0, &ts, nullptr);
+		}
+	}
+
+	return !QThread::currentThread()->isInterruptionRequested();
+}
+
+void SyncCoordinator::measureOffsets(uint64_t releaseTime, uint64_t releaseSpread, QByteArray &status) const
+{
+	// The start instant of each timer, in host time, is estimated from a timer read bracketed by two
+	// host clock reads. The sample with the narrowest bracket is kept, offsets are relative to device 0
+
+	QVector<int64_t> starts(m_sessions.size(), 0);
+	QVector<uint64_t> brackets(m_sessions.size(), UINT64_MAX);
+
+	for(int sample = 0; sample < OFFSET_SAMPLES; ++sample)
+	{
+		for(int i = 0; i < m_sessions.size(); ++i)
+		{
+			uint64_t before = hostTime();
+			uint64_t ticks = m_sessions[i]->m_device->timer()->getCurrentTime();
+			uint64_t after = hostTime();
+
+			if(after - before < brackets[i])
+			{
+				brackets[i] = after - before;
+				starts[i] = int64_t(before + (after - before) / 2) - int64_t(ticks * NS_PER_CYCLE);
+			}
+		}
+	}
+
+	appendAsBytes<uint64_t>(status, releaseTime);
+	appendAsBytes<uint64_t>(status, releaseSpread);
+	appendAsBytes<uint8_t>(status, m_sessions.size());
+
+	for(int i = 0; i < m_sessions.size(); ++i)
+	{
+		appendAsBytes<uint8_t>(status, i);
+		appendAsBytes<int64_t>(status, starts[i] - starts[0]);
+		appendAsBytes<uint32_t>(status, qMin<uint64_t>(brackets[i] / 2 + NS_PER_CYCLE, UINT32_MAX));
+	}
+}
@@ -0,0 +1,182 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <ZbntListener.hpp>
+
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <MessageUtils.hpp>
+
+ZbntListener::ZbntListener(QObject *parent)
+	: QObject(parent), m_library(ZBNT_PROFILE_PATH "/library")
+{ }
+
+ZbntListener::~ZbntListener()
+{
+	m_sync.stop();
+
+	for(auto it = m_pending.begin(); it != m_pending.end(); ++it)
+	{
+		::close(it.key());
+	}
+
+	for(int i = 0; i < m_sessions.size(); ++i)
+	{
+		m_threads[i]->quit();
+		m_threads[i]->wait();
+
+		delete m_sessions[i];
+		delete m_threads[i];
+	}
+}
+
+void ZbntListener::addSession(ZbntServer *session, AbstractDevice *device)
+{
+	// Each device is served from its own thread, running close to the device when possible
+
+	QThread *thread = new QThread();
+	thread->setObjectName(QString("session%1").arg(m_sessions.size()));
+
+	// The library is shared by all sessions, so every device sees the same content
+
+	session->setSyncCoordinator(&m_sync);
+	session->setContentLibrary(&m_library);
+	m_sync.addSession(session);
+
+	session->moveToThread(thread);
+	thread->start();
+
+	QMetaObject::invokeMethod(session, [device]() { device->pinThread(); }, Qt::QueuedConnection);
+
+	m_sessions.append(session);
+	m_threads.append(thread);
+}
+
+ZbntServer *ZbntListener::session(int idx) const
+{
+	return m_sessions.value(idx, nullptr);
+}
+
+int ZbntListener::sessionCount() const
+{
+	return m_sessions.size();
+}
+
+void ZbntListener::routeConnection(qintptr fd)
+{
+	if(fd == -1) return;
+
+	// The device is selected by the HELLO message, wait for it before handing the socket over
+
+	PendingConnection &conn = m_pending[fd];
+
+	conn.notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+	conn.timer = new QTimer(this);
+	conn.timer->setSingleShot(true);
+	conn.timer->start(MSG_HELLO_TIMEOUT);
+
+	connect(conn.notifier, &QSocketNotifier::activated, this, [this, fd]() { onPendingData(fd); });
+
+	connect(conn.timer, &QTimer::timeout, this,
+		[this, fd]()
+		{
+			qInfo("[net] I: Client timeout, HELLO message not received");
+			dropConnection(fd, true);
+		}
+	);
+}
+
+void ZbntListener::onPendingData(qintptr fd)
+{
+	auto it = m_pending.find(fd);
+
+	if(it == m_pending.end()) return;
+
+	QByteArray &data = it->data;
+	char buffer[MAX_HELLO_SIZE];
+	ssize_t count = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+	if(count <= 0)
+	{
+		if(count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+		{
+			dropConnection(fd, true);
+		}
+
+		return;
+	}
+
+	data.append(buffer, count);
+
+	if(data.size() < 8) return;
+
+	if(!data.startsWith(MSG_MAGIC_IDENTIFIER) || readAsNumber<quint16>(data, 4) != MSG_ID_HELLO)
+	{
+		qInfo("[net] I: Invalid first message, closing connection");
+		dropConnection(fd, true);
+		return;
+	}
+
+	quint16 size = readAsNumber<quint16>(data, 6);
+
+	if(size > MAX_HELLO_SIZE)
+	{
+		dropConnection(fd, true);
+		return;
+	}
+
+	if(data.size() < 8 + size) return;
+
+	// Clients that don't give a device index are attached to the first one
+
+	int index = size ? uint8_t(data[8]) : 0;
+
+	if(index >= m_sessions.size())
+	{
+		qInfo("[net] I: Client requested unknown device %d", index);
+		dropConnection(fd, true);
+		return;
+	}
+
+	QByteArray pending = data;
+	ZbntServer *session = m_sessions[index];
+
+	dropConnection(fd, false);
+
+	QMetaObject::invokeMethod(session, [session, fd, pending]() { session->acceptClient(fd, pending); }, Qt::QueuedConnection);
+}
+
+void ZbntListener::dropConnection(qintptr fd, bool close)
+{
+	auto it = m_pending.find(fd);
+
+	if(it == m_pending.end()) return;
+
+	it->notifier->setEnabled(false);
+	it->notifier->deleteLater();
+	it->timer->deleteLater();
+
+	m_pending.erase(it);
+
+	if(close)
+	{
+		::close(fd);
+	}
+}
@@ -0,0 +1,101 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <ZbntLocalListener.hpp>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <QCoreApplication>
+#include <QNetworkInterface>
+
+#include <ZbntLocalServer.hpp>
+
+ZbntLocalListener::ZbntLocalListener(const QString &name, const QVector<AbstractDevice*> &devices)
+{
+	for(AbstractDevice *device : devices)
+	{
+		addSession(new ZbntLocalServer(device), device);
+	}
+
+	// Setup local socket
+
+	m_server = new QLocalServer(this);
+
+	qintptr sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	qint64 pid = QCoreApplication::applicationPid();
+
+	if(sock == -1)
+		qFatal("[net] F: Can't create local socket");
+
+	sockaddr_un sockAddr;
+	memset(&sockAddr, 0, sizeof(sockAddr));
+	snprintf(sockAddr.sun_path + 1, sizeof(sockAddr.sun_path) - 1, "/tmp/zbnt-local-%016llX", pid);
+	sockAddr.sun_family = AF_UNIX;
+
+	if(bind(sock, (sockaddr*) &sockAddr, sizeof(sa_family_t) + 33) == -1)
+		qFatal("[net] F: Can't bind local socket");
+
+	if(listen(sock, m_server->maxPendingConnections()) == -1)
+		qFatal("[net] F: Can't listen on local socket");
+
+	if(!m_server->listen(sock))
+		qFatal("[net] F: Can't listen on local socket");
+
+	qInfo("[net] I: Listening on %s", qUtf8Printable(m_server->serverName()));
+
+	// Setup discovery server
+
+	for(const QNetworkInterface &iface : QNetworkInterface::allInterfaces())
+	{
+		if(!(iface.flags() & QNetworkInterface::IsUp))
+			continue;
+
+		switch(iface.type())
+		{
+			case QNetworkInterface::Loopback:
+			{
+				m_discoveryServer = new DiscoveryServer(name, devices.size(), this);
+			}
+
+			default: { }
+		}
+	}
+
+	// Connect signals
+
+	connect(m_server, &QLocalServer::newConnection, this, &ZbntLocalListener::onIncomingConnection);
+}
+
+ZbntLocalListener::~ZbntLocalListener()
+{ }
+
+void ZbntLocalListener::onIncomingConnection()
+{
+	while(m_server->hasPendingConnections())
+	{
+		// The session takes over a duplicate of the descriptor, the socket itself stays here
+
+		QLocalSocket *connection = m_server->nextPendingConnection();
+		routeConnection(dup(connection->socketDescriptor()));
+
+		connection->abort();
+		connection->deleteLater();
+	}
+}
@@ -18,68 +18,39 @@
 
 #include <ZbntLocalServer.hpp>
 
-#include <sys/socket.h>
-#include <sys/un.h>
-
-#include <QCoreApplication>
-
 #include <MessageUtils.hpp>
 
-ZbntLocalServer::ZbntLocalServer(const QString &name, AbstractDevice *parent)
+ZbntLocalServer::ZbntLocalServer(AbstractDevice *parent)
 	: ZbntServer(parent)
-{
-	// Setup local socket
-
-	m_server = new QLocalServer(this);
-
-	qintptr sock = socket(AF_UNIX, SOCK_STREAM, 0);
-	qint64 pid = QCoreApplication::applicationPid();
-
-	if(sock == -1)
-		qFatal("[net] F: Can't create local socket");
-
-	sockaddr_un sockAddr;
-	memset(&sockAddr, 0, sizeof(sockAddr));
-	snprintf(sockAddr.sun_path + 1, sizeof(sockAddr.sun_path) - 1, "/tmp/zbnt-local-%016llX", pid);
-	sockAddr.sun_family = AF_UNIX;
+{ }
 
-	if(bind(sock, (sockaddr*) &sockAddr, sizeof(sa_family_t) + 33) == -1)
-		qFatal("[net] F: Can't bind local socket");
+ZbntLocalServer::~ZbntLocalServer()
+{ }
 
-	if(listen(sock, m_server->maxPendingConnections()) == -1)
-		qFatal("[net] F: Can't listen on local socket");
+void ZbntLocalServer::acceptClient(qintptr fd, const QByteArray &pending)
+{
+	QLocalSocket *connection = new QLocalSocket(this);
+	connection->setSocketDescriptor(fd);
 
-	if(!m_server->listen(sock))
-		qFatal("[net] F: Can't listen on local socket");
+	if(!m_client)
+	{
+		m_client = connection;
 
-	qInfo("[net] I: Listening on %s", qUtf8Printable(m_server->serverName()));
+		qInfo("[net] I: Incoming connection");
+		m_helloTimer->start();
 
-	// Setup discovery server
+		connect(m_client, &QLocalSocket::readyRead, this, &ZbntLocalServer::onReadyRead);
+		connect(m_client, &QLocalSocket::stateChanged, this, &ZbntLocalServer::onNetworkStateChanged);
 
-	for(const QNetworkInterface &iface : QNetworkInterface::allInterfaces())
+		handleIncomingData(pending);
+	}
+	else
 	{
-		if(!(iface.flags() & QNetworkInterface::IsUp))
-			continue;
-
-		switch(iface.type())
-		{
-			case QNetworkInterface::Loopback:
-			{
-				m_discoveryServer = new DiscoveryServer(name, this);
-			}
-
-			default: { }
-		}
+		connection->abort();
+		connection->deleteLater();
 	}
-
-	// Connect signals
-
-	connect(m_server, &QLocalServer::newConnection, this, &ZbntLocalServer::onIncomingConnection);
 }
 
-ZbntLocalServer::~ZbntLocalServer()
-{ }
-
 bool ZbntLocalServer::clientAvailable() const
 {
 	return m_client != nullptr;
@@ -100,27 +71,6 @@ void ZbntLocalServer::sendMessage(MessageID id, const QByteArray &data)
 	writeMessage(m_client, id, data);
 }
 
-void ZbntLocalServer::onIncomingConnection()
-{
-	QLocalSocket *connection = m_server->nextPendingConnection();
-
-	if(!m_client)
-	{
-		m_client = connection;
-
-		qInfo("[net] I: Incoming connection");
-		m_helloTimer->start();
-
-		connect(m_client, &QLocalSocket::readyRead, this, &ZbntLocalServer::onReadyRead);
-		connect(m_client, &QLocalSocket::stateChanged, this, &ZbntLocalServer::onNetworkStateChanged);
-	}
-	else
-	{
-		connection->abort();
-		connection->deleteLater();
-	}
-}
-
 void ZbntLocalServer::onReadyRead()
 {
 	handleIncomingData(m_client->readAll());
@@ -147,6 +97,6 @@ void ZbntLocalServer::onNetworkStateChanged(QLocalSocket::LocalSocketState state
 		m_client->deleteLater();
 		m_client = nullptr;
 
-		stopRun();
+		onClientDisconnected();
 	}
 }
@@ -19,11 +19,17 @@
 #include <ZbntServer.hpp>
 
 #include <QThread>
+#include <QtEndian>
 #include <QNetworkInterface>
 
 #include <AbstractDevice.hpp>
 #include <IrqThread.hpp>
 #include <MessageUtils.hpp>
+#include <SyncCoordinator.hpp>
+#include <cores/StatsCollector.hpp>
+#include <engines/Rfc2544.hpp>
+#include <engines/RunQueue.hpp>
+#include <engines/Sweep.hpp>
 
 ZbntServer::ZbntServer(AbstractDevice *parent)
 	: QObject(nullptr), m_device(parent)
@@ -33,60 +39,142 @@ ZbntServer::ZbntServer(AbstractDevice *parent)
 	m_helloTimer->setSingleShot(true);
 
 	m_runEndTimer = new QTimer(this);
-	m_runEndTimer->setInterval(2000);
+	m_runEndTimer->setInterval(RUN_POLL_INTERVAL);
 	m_runEndTimer->setSingleShot(false);
 
+	m_subscriptionTimer = new QTimer(this);
+	m_subscriptionTimer->setSingleShot(false);
+	m_subscriptionTimer->setTimerType(Qt::PreciseTimer);
+	m_subscriptionClock.start();
+
+	m_counterTimer = new QTimer(this);
+	m_counterTimer->setSingleShot(false);
+	m_counterTimer->setTimerType(Qt::PreciseTimer);
+	m_counterTimer->setInterval(0);
+
+	// Reserved buffers keep their capacity when cleared, so replies don't allocate
+
+	m_response.reserve(RESPONSE_BUFFER_SIZE);
+	m_value.reserve(RESPONSE_BUFFER_SIZE);
+	m_tagged.reserve(RESPONSE_BUFFER_SIZE);
+
 	connect(parent->irqThread(), &IrqThread::interrupted, this, &ZbntServer::handleInterrupt, Qt::BlockingQueuedConnection);
 	connect(m_helloTimer, &QTimer::timeout, this, &ZbntServer::onHelloTimeout);
 	connect(m_runEndTimer, &QTimer::timeout, this, &ZbntServer::pollTimer);
+	connect(m_subscriptionTimer, &QTimer::timeout, this, &ZbntServer::pollSubscriptions);
+	connect(m_counterTimer, &QTimer::timeout, this, &ZbntServer::pollCounters);
 
 	m_runEndTimer->start();
 }
 
 ZbntServer::~ZbntServer()
-{ }
+{
+	delete m_profile;
+}
 
-void ZbntServer::startRun()
+void ZbntServer::startRun(bool stream)
 {
 	if(m_isRunning) return;
 
+	// Runs that aren't streamed still drain the DMA buffer, but nothing about them reaches the client
+
+	m_streaming = stream;
 	m_lastDmaIdx = 0;
 	m_dmaReachedEnd = false;
 	m_pendingDmaData.clear();
 	m_device->dmaEngine()->startTransfer();
 
-	if(clientAvailable())
+	if(clientAvailable() && m_streaming)
 	{
 		sendMessage(MSG_ID_RUN_START, QByteArray());
 	}
 
+	if(m_counterTimer->interval())
+	{
+		m_counterTimer->start();
+	}
+
 	m_isRunning = true;
 	qInfo("[net] I: Run started");
 }
 
+void ZbntServer::setSyncCoordinator(SyncCoordinator *sync)
+{
+	m_sync = sync;
+}
+
+void ZbntServer::setContentLibrary(ContentLibrary *library)
+{
+	m_library = library;
+}
+
+bool ZbntServer::armSync()
+{
+	// Everything a normal start does, except for enabling the timer, which the coordinator does later
+
+	if(m_isRunning || m_engine || m_loadingBitstream || !m_device->timer() || !m_device->dmaEngine())
+	{
+		return false;
+	}
+
+	m_device->timer()->setRunning(false);
+	startRun();
+
+	m_syncArmed = true;
+	return true;
+}
+
+void ZbntServer::disarmSync()
+{
+	m_syncArmed = false;
+	m_stopAfterSync = false;
+
+	stopRun();
+	replayDeferred();
+}
+
+void ZbntServer::finishSync(const QByteArray &status)
+{
+	// An empty status means the release was aborted and the timers never started
+
+	m_syncArmed = false;
+
+	if(status.isEmpty() || m_stopAfterSync)
+	{
+		stopRun();
+	}
+	else if(m_helloReceived && clientAvailable())
+	{
+		sendMessage(MSG_ID_SYNC_STATUS, status);
+	}
+
+	m_stopAfterSync = false;
+	replayDeferred();
+}
+
 void ZbntServer::stopRun()
 {
 	if(!m_isRunning) return;
 
 	m_device->timer()->setRunning(false);
+	m_counterTimer->stop();
+	stopProfile(false);
 
 	// Flush data still remaining in the FIFOs and stop DMA
 
 	m_device->dmaEngine()->flushFifo();
 
-	do
+	while(!m_device->dmaEngine()->isFlushDone())
 	{
-		QThread::usleep(100);
+		QThread::usleep(STOP_POLL_INTERVAL);
 	}
-	while(!m_device->dmaEngine()->isFlushDone());
 
 	m_device->dmaEngine()->stopTransfer();
 
-	do
+	while(m_device->dmaEngine()->isActive())
 	{
-		QThread::usleep(100);
+		QThread::usleep(STOP_POLL_INTERVAL);
 	}
-	while(m_device->dmaEngine()->isActive());
 
 	m_device->dmaEngine()->clearInterrupts(m_device->dmaEngine()->getActiveInterrupts());
 
@@ -94,9 +182,7 @@ void ZbntServer::stopRun()
 
 	uint64_t maxTime = m_device->timer()->getMaximumTime();
 
-	m_device->timer()->setReset(true);
-	QThread::msleep(100);
-	m_device->timer()->setReset(false);
+	m_device->timer()->pulseReset();
 
 	m_device->timer()->setMaximumTime(maxTime);
 
@@ -109,7 +195,7 @@ void ZbntServer::stopRun()
 
 	// Notify client, if available
 
-	if(clientAvailable())
+	if(clientAvailable() && m_streaming)
 	{
 		for(AbstractCore *dev : m_device->coreList())
 		{
@@ -132,9 +218,362 @@ void ZbntServer::stopRun()
 
 	m_isRunning = false;
 	qInfo("[net] I: Run stopped");
+
+	// Let the active engine, if any, continue once this run is done
+
+	if(m_engine)
+	{
+		AbstractEngine *engine = m_engine;
+
+		QTimer::singleShot(0, engine,
+			[this, engine]()
+			{
+				if(m_engine == engine)
+				{
+					engine->onRunStopped();
+				}
+			}
+		);
+	}
+}
+
+bool ZbntServer::startProfile(const QByteArray &data)
+{
+	// u16 number of steps, then u64 time in timer cycles, u8 core, u16 property, u16 length and value for
+	// each of them. Steps must be sorted by time, and only traffic generators can be profiled
+
+	if(m_profile || m_engine || !m_device->timer()) return false;
+	if(data.length() < 2) return false;
+
+	uint16_t count = qFromLittleEndian<uint16_t>(data.constData());
+	ProfileList steps;
+	int offset = 2;
+
+	for(int i = 0; i < count; ++i)
+	{
+		if(offset + 13 > data.length()) return false;
+
+		ProfileStep step;
+		step.time = qFromLittleEndian<uint64_t>(data.constData() + offset);
+		step.devID = data[offset + 8];
+		step.propID = PropertyID(qFromLittleEndian<uint16_t>(data.constData() + offset + 9));
+		step.core = findCore(step.devID);
+
+		uint16_t length = qFromLittleEndian<uint16_t>(data.constData() + offset + 11);
+
+		if(offset + 13 + length > data.length()) return false;
+		if(!step.core || step.core->getType() != DEV_TRAFFIC_GENERATOR) return false;
+		if(step.core->isAsyncProperty(step.propID)) return false;
+		if(findRateController(step.devID) != -1) return false;
+		if(steps.size() && step.time < steps.last().time) return false;
+
+		step.value = data.mid(offset + 13, length);
+		steps.append(step);
+
+		offset += 13 + length;
+	}
+
+	if(steps.isEmpty()) return false;
+
+	// Notifications from profiles that were already stopped are ignored
+
+	uint32_t serial = ++m_profileSerial;
+
+	m_profile = new ProfileThread(m_device->timer(), steps, this,
+		[this, serial](int index, uint64_t intended, uint64_t actual, bool ok)
+		{
+			if(!clientAvailable() || serial != m_profileSerial) return;
+
+			QByteArray message;
+			appendAsBytes<uint16_t>(message, index);
+			appendAsBytes<uint64_t>(message, intended);
+			appendAsBytes<uint64_t>(message, actual);
+			appendAsBytes<uint8_t>(message, ok);
+
+			sendMessage(MSG_ID_PROFILE_STEP, message);
+		},
+		[this, serial](bool completed)
+		{
+			if(m_profile && serial == m_profileSerial)
+			{
+				stopProfile(completed);
+			}
+		}
+	);
+
+	m_profile->start(QThread::TimeCriticalPriority);
+
+	qInfo("[net] I: Profile started with %d steps", steps.size());
+	return true;
+}
+
+void ZbntServer::stopProfile(bool completed)
+{
+	if(!m_profile) return;
+
+	m_profile->stop();
+	delete m_profile;
+	m_profile = nullptr;
+	m_profileSerial++;
+
+	if(clientAvailable())
+	{
+		QByteArray message;
+		appendAsBytes<uint8_t>(message, completed);
+
+		sendMessage(MSG_ID_PROFILE_DONE, message);
+	}
+
+	qInfo("[net] I: Profile %s", completed ? "finished" : "stopped");
+}
+
+bool ZbntServer::setRateControl(const QByteArray &data, uint32_t &gap)
+{
+	if(data.size() < 15) return false;
+
+	uint8_t generatorID = readAsNumber<uint8_t>(data, 0);
+	uint8_t statsID = readAsNumber<uint8_t>(data, 1);
+	uint8_t mode = readAsNumber<uint8_t>(data, 2);
+	uint64_t target = readAsNumber<uint64_t>(data, 3);
+	uint32_t tolerance = readAsNumber<uint32_t>(data, 11);
+
+	AbstractCore *generator = findCore(generatorID);
+	AbstractCore *stats = findCore(statsID);
+
+	if(!generator || generator->getType() != DEV_TRAFFIC_GENERATOR) return false;
+
+	// Engines and profiles write the gaps themselves, a controller would fight them
+
+	if(m_engine || (m_profile && m_profile->usesCore(generatorID))) return false;
+
+	// Only one controller may drive each generator, a new target replaces the previous one
+
+	int current = findRateController(generatorID);
+
+	if(current != -1)
+	{
+		delete m_rateControllers.takeAt(current);
+	}
+
+	if(!target) return true;
+	if(!stats || stats->getType() != DEV_STATS_COLLECTOR) return false;
+
+	RateController *controller = new RateController(generator, (StatsCollector*) stats, this);
+
+	if(!controller->setTarget(RateController::Mode(mode), target, tolerance))
+	{
+		delete controller;
+		return false;
+	}
+
+	controller->setCallback(
+		[this] (uint8_t devID, uint64_t measured, uint32_t frameGap)
+		{
+			if(!clientAvailable()) return;
+
+			QByteArray message;
+			appendAsBytes<uint8_t>(message, devID);
+			appendAsBytes<uint64_t>(message, measured);
+			appendAsBytes<uint32_t>(message, frameGap);
+
+			sendMessage(MSG_ID_RATE_STATUS, message);
+		}
+	);
+
+	m_rateControllers.append(controller);
+	gap = controller->getFrameGap();
+	return true;
+}
+
+void ZbntServer::clearRateControl()
+{
+	qDeleteAll(m_rateControllers);
+	m_rateControllers.clear();
+}
+
+int ZbntServer::findRateController(uint8_t devID) const
+{
+	for(int i = 0; i < m_rateControllers.size(); ++i)
+	{
+		if(m_rateControllers[i]->getGeneratorIndex() == devID)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+bool ZbntServer::isRateControlled(uint8_t devID, PropertyID propID, const QByteArray &value) const
+{
+	// The gap of a generator driven by a rate controller is only written by the controller
+
+	if(propID != PROP_FRAME_GAP && propID != PROP_BULK) return false;
+	if(findRateController(devID) == -1) return false;
+	if(propID == PROP_FRAME_GAP) return true;
+
+	for(int i = 0; i + 4 <= value.length(); i += 4 + readAsNumber<uint16_t>(value, i + 2))
+	{
+		if(readAsNumber<uint16_t>(value, i) == PROP_FRAME_GAP)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ZbntServer::onClientDisconnected()
+{
+	m_deferred.clear();
+
+	cancelEngine();
+	stopProfile(false);
+	clearRateControl();
+
+	// The coordinator still owns the timer of an armed device, stop once it's released
+
+	if(m_syncArmed)
+	{
+		m_stopAfterSync = true;
+		return;
+	}
+
+	stopRun();
+}
+
+void ZbntServer::startEngine(AbstractEngine *engine)
+{
+	// Engines set the gaps of every generator they use, any rate controller would overwrite them
+
+	clearRateControl();
+
+	m_engine = engine;
+	m_engineSavedLimit = m_device->timer()->getMaximumTime();
+	m_runEndTimer->setInterval(ENGINE_POLL_INTERVAL);
+
+	engine->start();
+}
+
+void ZbntServer::cancelEngine()
+{
+	if(m_engine)
+	{
+		onEngineFinished(m_engine, false);
+	}
+}
+
+void ZbntServer::onEngineFinished(AbstractEngine *engine, bool completed)
+{
+	if(m_engine != engine) return;
+
+	m_engine = nullptr;
+	m_runEndTimer->setInterval(RUN_POLL_INTERVAL);
+
+	stopRun();
+	m_device->timer()->setMaximumTime(m_engineSavedLimit);
+
+	if(clientAvailable())
+	{
+		QByteArray message;
+		appendAsBytes<uint8_t>(message, engine->getType());
+		appendAsBytes<uint8_t>(message, completed);
+
+		sendMessage(MSG_ID_ENGINE_DONE, message);
+	}
+
+	qInfo("[engine] I: Engine %s", completed ? "finished" : "cancelled");
+	engine->deleteLater();
 }
 
 void ZbntServer::onMessageReceived(quint16 id, const QByteArray &data)
+{
+	// Keep the order of messages once one of them has to wait
+
+	if(m_loadingBitstream || !m_deferred.isEmpty() || (m_syncArmed && changesRun(id, data)))
+	{
+		m_deferred.append({id, QByteArray(data.constData(), data.size())});
+		return;
+	}
+
+	dispatchMessage(id, data);
+}
+
+bool ZbntServer::changesRun(quint16 id, const QByteArray &data)
+{
+	if(id == MSG_ID_TAGGED_REQUEST)
+	{
+		if(data.length() < 6) return false;
+
+		id = qFromLittleEndian<uint16_t>(data.constData() + 4);
+	}
+
+	switch(id)
+	{
+		case MSG_ID_PROGRAM_PL:
+		case MSG_ID_RUN_START:
+		case MSG_ID_RUN_STOP:
+		case MSG_ID_SYNC_START:
+		case MSG_ID_RUN_QUEUE:
+		case MSG_ID_RFC2544:
+		case MSG_ID_SWEEP:
+		case MSG_ID_PROFILE:
+		case MSG_ID_PROFILE_STOP:
+		case MSG_ID_ENGINE_CANCEL:
+		case MSG_ID_RATE_CONTROL:
+		case MSG_ID_SET_PROPERTY:
+		case MSG_ID_STAGE_COMMIT:
+		{
+			return true;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+void ZbntServer::replayDeferred()
+{
+	// Handle whatever arrived while waiting, stopping again if one of them has to wait too
+
+	while(!m_loadingBitstream && !m_deferred.isEmpty())
+	{
+		const DeferredMessage &msg = m_deferred.first();
+
+		if(m_syncArmed && changesRun(msg.id, msg.data))
+		{
+			break;
+		}
+
+		DeferredMessage next = m_deferred.takeFirst();
+		dispatchMessage(next.id, next.data);
+	}
+}
+
+void ZbntServer::dispatchMessage(quint16 id, const QByteArray &data)
+{
+	// Tagged requests carry an ID that is echoed back with the response, allowing
+	// clients to keep several of them in flight and match replies as they arrive
+
+	if(id == MSG_ID_TAGGED_REQUEST)
+	{
+		if(data.length() < 6) return;
+
+		RequestTag tag = {true, qFromLittleEndian<uint32_t>(data.constData())};
+		uint16_t innerID = qFromLittleEndian<uint16_t>(data.constData() + 4);
+
+		if(innerID == MSG_ID_TAGGED_REQUEST) return;
+
+		handleMessage(innerID, QByteArray::fromRawData(data.constData() + 6, data.length() - 6), tag);
+		return;
+	}
+
+	handleMessage(id, data, {false, 0});
+}
+
+void ZbntServer::handleMessage(quint16 id, const QByteArray &data, const RequestTag &tag)
 {
 	switch(id)
 	{
@@ -154,7 +593,17 @@ void ZbntServer::onMessageReceived(quint16 id, const QByteArray &data)
 
 			m_helloReceived = true;
 			m_helloTimer->stop();
-			sendMessage(MSG_ID_HELLO, bitstreamList);
+			m_session++;
+
+			m_subscriptions.clear();
+			updateSubscriptionTimer();
+
+			m_counterTimer->setInterval(0);
+			m_counterCores.clear();
+			m_staged.clear();
+			clearRateControl();
+
+			sendReply(tag, MSG_ID_HELLO, bitstreamList);
 
 			QByteArray message;
 			QByteArray activeBitstream = m_device->activeBitstream().toUtf8();
@@ -179,38 +628,52 @@ void ZbntServer::onMessageReceived(quint16 id, const QByteArray &data)
 			if(!m_helloReceived) break;
 			if(data.length() < 3) break;
 
+			cancelEngine();
+			stopProfile(false);
+			clearRateControl();
+
+			stopRun();
+
 			uint16_t nameLength = readAsNumber<uint16_t>(data, 0);
-			QByteArray reqBitstream = data.mid(2, nameLength);
-			QString reqBitstreamName = QString::fromUtf8(reqBitstream);
-			QByteArray response;
+			QString reqBitstreamName = QString::fromUtf8(data.mid(2, nameLength));
 
-			appendAsBytes<uint8_t>(response, m_device->loadBitstream(reqBitstreamName));
-			reqBitstream = m_device->activeBitstream().toUtf8();
+			// The pollers keep pointers and indexes of the cores that are about to be replaced
 
-			appendAsBytes<uint16_t>(response, reqBitstream.size());
-			response.append(reqBitstream);
+			m_counterTimer->stop();
+			m_counterTimer->setInterval(0);
+			m_counterCores.clear();
+			m_staged.clear();
 
-			for(const AbstractCore *dev : m_device->coreList())
-			{
-				dev->announce(response);
-			}
+			m_subscriptions.clear();
+			updateSubscriptionTimer();
 
-			m_device->timer()->announce(response);
+			// The load completes in the background, messages received until then are kept and handled afterwards
 
-			uint8_t *buffer = m_device->dmaBuffer()->getVirtualAddr();
-			uint32_t bufferSize = m_device->dmaBuffer()->getSize();
+			m_loadingBitstream = true;
+			m_loadClock.start();
 
-			memset(buffer, 0, bufferSize);
+			m_device->loadBitstreamAsync(reqBitstreamName, this,
+				[this, tag](bool ok, uint64_t switchTime)
+				{
+					finishBitstream(tag, ok, switchTime);
+				}
+			);
 
-			sendMessage(MSG_ID_PROGRAM_PL, response);
 			break;
 		}
 
 		case MSG_ID_RUN_START:
 		{
 			if(!m_helloReceived) break;
+			if(m_engine) break;
 
 			startRun();
+
+			if(tag.valid)
+			{
+				sendReply(tag, MSG_ID_RUN_START, QByteArray());
+			}
+
 			break;
 		}
 
@@ -218,7 +681,14 @@ void ZbntServer::onMessageReceived(quint16 id, const QByteArray &data)
 		{
 			if(!m_helloReceived) break;
 
+			cancelEngine();
 			stopRun();
+
+			if(tag.valid)
+			{
+				sendReply(tag, MSG_ID_RUN_STOP, QByteArray());
+			}
+
 			break;
 		}
 
@@ -227,27 +697,58 @@ void ZbntServer::onMessageReceived(quint16 id, const QByteArray &data)
 			if(!m_helloReceived) break;
 			if(data.length() < 3) break;
 
+			// The value is a view into the receive buffer, it must be copied if kept
+
 			uint8_t devID = data[0];
-			PropertyID propID = PropertyID(readAsNumber<uint16_t>(data, 1));
-			QByteArray value = data.mid(3);
+			PropertyID propID = PropertyID(qFromLittleEndian<uint16_t>(data.constData() + 1));
+			QByteArray value = QByteArray::fromRawData(data.constData() + 3, data.length() - 3);
+			AbstractCore *core = findCore(devID);
 			bool ok = false;
 
-			if(devID < m_device->coreList().length())
+			// Cores driven by a running profile are written from its thread, reject concurrent writes
+
+			if(m_profile && m_profile->usesCore(devID))
+			{
+				core = nullptr;
+			}
+
+			if(isRateControlled(devID, propID, value))
 			{
-				ok = m_device->coreList().at(devID)->setProperty(propID, value);
+				core = nullptr;
 			}
-			else if(devID == 0xFF)
+
+			if(core && core->isAsyncProperty(propID))
 			{
-				ok = m_device->timer()->setProperty(propID, value);
+				core->setPropertyAsync(propID, QByteArray(value.constData(), value.length()), this,
+					[this, devID, propID, tag, session = m_session](bool ok, const QByteArray &value)
+					{
+						if(!clientAvailable() || !m_helloReceived || session != m_session) return;
+
+						QByteArray response;
+						appendAsBytes<uint8_t>(response, devID);
+						appendAsBytes<uint16_t>(response, propID);
+						appendAsBytes<uint8_t>(response, ok);
+						response.append(value);
+
+						sendReply(tag, MSG_ID_SET_PROPERTY, response);
+					}
+				);
+
+				break;
 			}
 
-			QByteArray response;
-			appendAsBytes<uint8_t>(response, devID);
-			appendAsBytes<uint16_t>(response, propID);
-			appendAsBytes<uint8_t>(response, ok);
-			response.append(value);
+			if(core)
+			{
+				ok = applyProperty(core, propID, value);
+			}
+
+			m_response.resize(0);
+			appendAsBytes<uint8_t>(m_response, devID);
+			appendAsBytes<uint16_t>(m_response, propID);
+			appendAsBytes<uint8_t>(m_response, ok);
+			m_response.append(value);
 
-			sendMessage(MSG_ID_SET_PROPERTY, response);
+			sendReply(tag, MSG_ID_SET_PROPERTY, m_response);
 			break;
 		}
 
@@ -257,44 +758,577 @@ void ZbntServer::onMessageReceived(quint16 id, const QByteArray &data)
 			if(data.length() < 3) break;
 
 			uint8_t devID = data[0];
-			PropertyID propID = PropertyID(readAsNumber<uint16_t>(data, 1));
-			QByteArray params = data.mid(3);
-			QByteArray value;
+			PropertyID propID = PropertyID(qFromLittleEndian<uint16_t>(data.constData() + 1));
+			QByteArray params = QByteArray::fromRawData(data.constData() + 3, data.length() - 3);
+			AbstractCore *core = findCore(devID);
 			bool ok = false;
 
-			if(devID < m_device->coreList().length())
+			if(core && core->isAsyncProperty(propID))
 			{
-				ok = m_device->coreList().at(devID)->getProperty(propID, params, value);
+				params = QByteArray(params.constData(), params.length());
+
+				core->getPropertyAsync(propID, params, this,
+					[this, devID, propID, params, tag, session = m_session](bool ok, const QByteArray &value)
+					{
+						if(!clientAvailable() || !m_helloReceived || session != m_session) return;
+
+						QByteArray response;
+						appendAsBytes<uint8_t>(response, devID);
+						appendAsBytes<uint16_t>(response, propID);
+						appendAsBytes<uint8_t>(response, ok);
+						response.append(params);
+						response.append(value);
+
+						sendReply(tag, MSG_ID_GET_PROPERTY, response);
+					}
+				);
+
+				break;
 			}
-			else if(devID == 0xFF)
+
+			m_value.resize(0);
+
+			if(core)
 			{
-				ok = m_device->timer()->getProperty(propID, params, value);
+				if(propID == PROP_BULK)
+				{
+					ok = core->getPropertyBulk(params, m_value);
+				}
+				else
+				{
+					ok = core->getProperty(propID, params, m_value);
+				}
 			}
 
-			QByteArray response;
-			appendAsBytes<uint8_t>(response, devID);
-			appendAsBytes<uint16_t>(response, propID);
-			appendAsBytes<uint8_t>(response, ok);
-			response.append(params);
-			response.append(value);
+			m_response.resize(0);
+			appendAsBytes<uint8_t>(m_response, devID);
+			appendAsBytes<uint16_t>(m_response, propID);
+			appendAsBytes<uint8_t>(m_response, ok);
+			m_response.append(params);
+			m_response.append(m_value);
 
-			sendMessage(MSG_ID_GET_PROPERTY, response);
+			sendReply(tag, MSG_ID_GET_PROPERTY, m_response);
 			break;
 		}
 
-		default:
+		case MSG_ID_SNAPSHOT:
 		{
-			break;
-		}
-	}
-}
+			if(!m_helloReceived) break;
 
-void ZbntServer::handleInterrupt()
+			// An empty list selects every core, those without counters are skipped
+
+			CoreList cores;
+
+			if(data.isEmpty())
+			{
+				cores = m_device->coreList();
+			}
+			else
+			{
+				for(uint8_t devID : data)
+				{
+					if(devID < m_device->coreList().length())
+					{
+						cores.append(m_device->coreList().at(devID));
+					}
+				}
+			}
+
+			QByteArray response;
+			m_device->takeSnapshot(cores, response);
+
+			sendReply(tag, MSG_ID_SNAPSHOT, response);
+			break;
+		}
+
+		case MSG_ID_SUBSCRIBE:
+		{
+			if(!m_helloReceived) break;
+			if(data.length() < 5) break;
+
+			// Subscriptions are identified by core, property and parameters, an interval of zero removes them
+
+			uint8_t devID = data[0];
+			PropertyID propID = PropertyID(qFromLittleEndian<uint16_t>(data.constData() + 1));
+			uint16_t interval = qFromLittleEndian<uint16_t>(data.constData() + 3);
+			QByteArray params = data.mid(5);
+			AbstractCore *core = findCore(devID);
+			bool ok = false;
+
+			for(int i = 0; i < m_subscriptions.size(); ++i)
+			{
+				const Subscription &sub = m_subscriptions[i];
+
+				if(sub.devID == devID && sub.propID == propID && sub.params == params)
+				{
+					m_subscriptions.remove(i);
+					ok = !interval;
+					break;
+				}
+			}
+
+			if(interval && core && !core->isAsyncProperty(propID))
+			{
+				QByteArray value;
+
+				if(core->getProperty(propID, params, value))
+				{
+					interval = qMax<uint16_t>(interval, MIN_SUBSCRIPTION_INTERVAL);
+					m_subscriptions.append({devID, propID, params, interval, 0, QByteArray()});
+					ok = true;
+				}
+			}
+
+			updateSubscriptionTimer();
+
+			QByteArray response = data.left(5);
+			appendAsBytes<uint8_t>(response, ok);
+
+			sendReply(tag, MSG_ID_SUBSCRIBE, response);
+			break;
+		}
+
+		case MSG_ID_POLLER_CONFIG:
+		{
+			if(!m_helloReceived) break;
+			if(data.length() < 2) break;
+
+			// Counters of the selected cores are sampled together and sent as part of the
+			// measurement stream while a run is active, an empty list selects every core
+
+			uint16_t interval = qFromLittleEndian<uint16_t>(data.constData());
+
+			m_counterCores.clear();
+
+			for(int i = 2; i < data.length(); ++i)
+			{
+				uint8_t devID = data[i];
+
+				if(devID < m_device->coreList().length())
+				{
+					m_counterCores.append(m_device->coreList().at(devID));
+				}
+			}
+
+			if(data.length() == 2)
+			{
+				m_counterCores = m_device->coreList();
+			}
+
+			m_counterTimer->setInterval(interval);
+
+			if(!interval)
+			{
+				m_counterTimer->stop();
+			}
+			else if(m_isRunning)
+			{
+				m_counterTimer->start();
+			}
+
+			QByteArray response = data.left(2);
+			appendAsBytes<uint8_t>(response, true);
+
+			sendReply(tag, MSG_ID_POLLER_CONFIG, response);
+			break;
+		}
+
+		case MSG_ID_STAGE_PROPERTY:
+		{
+			if(!m_helloReceived) break;
+			if(data.length() < 3) break;
+
+			// Same payload as SET_PROPERTY, the write is only performed on commit
+
+			uint8_t devID = data[0];
+			PropertyID propID = PropertyID(qFromLittleEndian<uint16_t>(data.constData() + 1));
+			QByteArray value = data.mid(3);
+			AbstractCore *core = findCore(devID);
+			bool ok = core && !(m_profile && m_profile->usesCore(devID)) && !isRateControlled(devID, propID, value);
+
+			// Bulk writes are staged as separate entries, so the enables they carry are held back too
+
+			QVector<StagedWrite> writes;
+
+			if(ok && propID == PROP_BULK)
+			{
+				for(int i = 0; i + 4 <= value.length();)
+				{
+					PropertyID entryID = PropertyID(readAsNumber<uint16_t>(value, i));
+					uint16_t length = readAsNumber<uint16_t>(value, i + 2);
+
+					if(i + 4 + length > value.length() || entryID == PROP_BULK)
+					{
+						ok = false;
+						break;
+					}
+
+					writes.append({devID, entryID, value.mid(i + 4, length)});
+					i += 4 + length;
+				}
+			}
+			else
+			{
+				writes.append({devID, propID, value});
+			}
+
+			for(const StagedWrite &write : writes)
+			{
+				ok = ok && !core->isAsyncProperty(write.propID);
+			}
+
+			if(ok)
+			{
+				m_staged.append(writes);
+			}
+
+			QByteArray response = data.left(3);
+			appendAsBytes<uint8_t>(response, ok);
+
+			sendReply(tag, MSG_ID_STAGE_PROPERTY, response);
+			break;
+		}
+
+		case MSG_ID_STAGE_COMMIT:
+		{
+			if(!m_helloReceived) break;
+
+			QByteArray response;
+			commitStaged(response);
+
+			sendReply(tag, MSG_ID_STAGE_COMMIT, response);
+			break;
+		}
+
+		case MSG_ID_STAGE_CLEAR:
+		{
+			if(!m_helloReceived) break;
+
+			m_staged.clear();
+
+			sendReply(tag, MSG_ID_STAGE_CLEAR, QByteArray());
+			break;
+		}
+
+		case MSG_ID_RUN_QUEUE:
+		case MSG_ID_RFC2544:
+		case MSG_ID_SWEEP:
+		{
+			if(!m_helloReceived) break;
+
+			AbstractEngine *engine = nullptr;
+
+			if(id == MSG_ID_RUN_QUEUE)
+			{
+				engine = new RunQueue(this);
+			}
+			else if(id == MSG_ID_RFC2544)
+			{
+				engine = new Rfc2544(this);
+			}
+			else
+			{
+				engine = new Sweep(this);
+			}
+
+			bool ok = !m_engine && !m_profile && !m_isRunning && m_device->timer() && engine->load(data);
+
+			QByteArray response;
+			appendAsBytes<uint8_t>(response, ok);
+
+			sendReply(tag, MessageID(id), response);
+
+			if(ok)
+			{
+				startEngine(engine);
+			}
+			else
+			{
+				delete engine;
+			}
+
+			break;
+		}
+
+		case MSG_ID_PROFILE:
+		{
+			if(!m_helloReceived) break;
+
+			bool ok = startProfile(data);
+
+			QByteArray response;
+			appendAsBytes<uint8_t>(response, ok);
+
+			sendReply(tag, MSG_ID_PROFILE, response);
+			break;
+		}
+
+		case MSG_ID_PROFILE_STOP:
+		{
+			if(!m_helloReceived) break;
+
+			QByteArray response;
+			appendAsBytes<uint8_t>(response, m_profile != nullptr);
+
+			sendReply(tag, MSG_ID_PROFILE_STOP, response);
+			stopProfile(false);
+			break;
+		}
+
+		case MSG_ID_RATE_CONTROL:
+		{
+			if(!m_helloReceived) break;
+
+			uint32_t gap = 0;
+			bool ok = setRateControl(data, gap);
+
+			QByteArray response;
+			appendAsBytes<uint8_t>(response, ok);
+			appendAsBytes<uint32_t>(response, gap);
+
+			sendReply(tag, MSG_ID_RATE_CONTROL, response);
+			break;
+		}
+
+		case MSG_ID_SYNC_START:
+		{
+			if(!m_helloReceived) break;
+			if(data.size() < 8) break;
+
+			// A release time of zero starts all devices right away, otherwise it's a host clock instant in ns
+
+			uint64_t releaseTime = readAsNumber<uint64_t>(data, 0);
+			bool ok = m_sync && m_sync->start(this, releaseTime);
+
+			QByteArray response;
+			appendAsBytes<uint8_t>(response, ok);
+			appendAsBytes<uint64_t>(response, SyncCoordinator::hostTime());
+
+			sendReply(tag, MSG_ID_SYNC_START, response);
+			break;
+		}
+
+		case MSG_ID_ENGINE_CANCEL:
+		{
+			if(!m_helloReceived) break;
+
+			QByteArray response;
+			appendAsBytes<uint8_t>(response, m_engine != nullptr);
+
+			cancelEngine();
+
+			sendReply(tag, MSG_ID_ENGINE_CANCEL, response);
+			break;
+		}
+
+		case MSG_ID_LIBRARY_STORE:
+		case MSG_ID_LIBRARY_QUERY:
+		case MSG_ID_LIBRARY_REMOVE:
+		{
+			if(!m_helloReceived) break;
+
+			ContentLibrary::EntryType type;
+			QString name;
+			int end = 0;
+
+			if(!m_library) break;
+			if(!parseLibraryRequest(data, type, name, end)) break;
+
+			QByteArray response = data.left(end);
+			QByteArray hash;
+			uint32_t size = 0;
+			bool ok = false;
+
+			if(id == MSG_ID_LIBRARY_STORE)
+			{
+				ok = m_library->store(type, name, data.mid(end), hash);
+				size = data.length() - end;
+			}
+			else if(id == MSG_ID_LIBRARY_QUERY)
+			{
+				ok = m_library->query(type, name, hash, size);
+			}
+			else
+			{
+				ok = m_library->remove(type, name);
+			}
+
+			appendAsBytes<uint8_t>(response, ok);
+
+			if(ok && id != MSG_ID_LIBRARY_REMOVE)
+			{
+				response.append(hash);
+				appendAsBytes<uint32_t>(response, size);
+			}
+
+			sendReply(tag, MessageID(id), response);
+			break;
+		}
+
+		default:
+		{
+			break;
+		}
+	}
+}
+
+void ZbntServer::finishBitstream(const RequestTag &tag, bool ok, uint64_t switchTime)
+{
+	uint64_t totalTime = m_loadClock.nsecsElapsed() / 1000;
+	m_loadingBitstream = false;
+
+	qInfo("[dev] I: Bitstream switch took %llu us, %llu us in total", (unsigned long long) switchTime, (unsigned long long) totalTime);
+
+	if(clientAvailable())
+	{
+		QByteArray response;
+		QByteArray bitstream = m_device->activeBitstream().toUtf8();
+
+		appendAsBytes<uint8_t>(response, ok);
+		appendAsBytes<uint16_t>(response, bitstream.size());
+		response.append(bitstream);
+
+		for(const AbstractCore *dev : m_device->coreList())
+		{
+			dev->announce(response);
+		}
+
+		if(m_device->timer())
+		{
+			m_device->timer()->announce(response);
+		}
+
+		sendReply(tag, MSG_ID_PROGRAM_PL, response);
+
+		QByteArray timing;
+		appendAsBytes<uint8_t>(timing, ok);
+		appendAsBytes<uint32_t>(timing, qMin<uint64_t>(switchTime, UINT32_MAX));
+		appendAsBytes<uint32_t>(timing, qMin<uint64_t>(totalTime, UINT32_MAX));
+
+		sendMessage(MSG_ID_BITSTREAM_TIMING, timing);
+	}
+
+	uint8_t *buffer = m_device->dmaBuffer()->getVirtualAddr();
+	uint32_t bufferSize = m_device->dmaBuffer()->getSize();
+
+	memset(buffer, 0, bufferSize);
+
+	replayDeferred();
+}
+
+void ZbntServer::sendReply(const RequestTag &tag, MessageID id, const QByteArray &data)
+{
+	if(!tag.valid)
+	{
+		sendMessage(id, data);
+		return;
+	}
+
+	m_tagged.resize(0);
+	appendAsBytes<uint32_t>(m_tagged, tag.id);
+	appendAsBytes<uint16_t>(m_tagged, id);
+	m_tagged.append(data);
+
+	sendMessage(MSG_ID_TAGGED_RESPONSE, m_tagged);
+}
+
+AbstractCore *ZbntServer::findCore(uint8_t devID) const
+{
+	if(devID < m_device->coreList().length())
+	{
+		return m_device->coreList().at(devID);
+	}
+	else if(devID == 0xFF)
+	{
+		return m_device->timer();
+	}
+
+	return nullptr;
+}
+
+bool ZbntServer::applyProperty(AbstractCore *core, PropertyID propID, const QByteArray &value)
+{
+	if(propID == PROP_TEMPLATE_REF || propID == PROP_SCRIPT_REF)
+	{
+		return setLibraryProperty(core, propID, value);
+	}
+
+	if(propID == PROP_BULK)
+	{
+		return core->setPropertyBulk(value);
+	}
+
+	return core->setProperty(propID, value);
+}
+
+bool ZbntServer::setLibraryProperty(AbstractCore *core, PropertyID propID, const QByteArray &value)
+{
+	// References are expanded to the payload the core would have received from the client
+
+	if(!m_library) return false;
+
+	QByteArray content;
+	QByteArray payload;
+
+	if(propID == PROP_TEMPLATE_REF)
+	{
+		if(!m_library->load(ContentLibrary::ENTRY_TEMPLATE, QString::fromUtf8(value), content)) return false;
+
+		payload.reserve(value.length() + content.length() + 1);
+		payload.append(value);
+		payload.push_back('\0');
+		payload.append(content);
+
+		return core->setProperty(PROP_FRAME_TEMPLATE, payload);
+	}
+
+	if(value.length() < 5) return false;
+	if(!m_library->load(ContentLibrary::ENTRY_SCRIPT, QString::fromUtf8(value.mid(4)), content)) return false;
+
+	payload.reserve(value.length() + content.length() + 1);
+	payload.append(value);
+	payload.push_back('\0');
+	payload.append(content);
+
+	return core->setProperty(PROP_FRAME_SCRIPT, payload);
+}
+
+bool ZbntServer::parseLibraryRequest(const QByteArray &data, ContentLibrary::EntryType &type, QString &name, int &end) const
+{
+	if(data.length() < 3) return false;
+
+	type = ContentLibrary::EntryType(readAsNumber<uint8_t>(data, 0));
+
+	if(type >= ContentLibrary::ENTRY_TYPE_COUNT) return false;
+
+	uint16_t nameLength = readAsNumber<uint16_t>(data, 1);
+	end = 3 + nameLength;
+
+	if(data.length() < end) return false;
+
+	name = QString::fromUtf8(data.mid(3, nameLength));
+	return true;
+}
+
+void ZbntServer::handleInterrupt()
 {
 	uint8_t *buffer = m_device->dmaBuffer()->getVirtualAddr();
 	uint32_t bufferSize = m_device->dmaBuffer()->getSize();
 	uint32_t msgEnd = m_device->dmaEngine()->getLastMessageEnd();
-	uint16_t irq = m_device->dmaEngine()->getActiveInterrupts();
+	uint16_t irq = m_device->interruptSources();
+
+	if(!irq)
+	{
+		irq = m_device->dmaEngine()->getActiveInterrupts();
+	}
+	else if(!(irq & AxiDma::IRQ_MEM_END) && !m_dmaReachedEnd && msgEnd < m_lastDmaIdx)
+	{
+		// The sources were collected before msgEnd was read and the DMA wrapped in between,
+		// leave everything to the IRQ_MEM_END interrupt that is still on its way
+
+		m_device->dmaEngine()->clearInterrupts(irq);
+		return;
+	}
 
 	if(irq && (!m_dmaReachedEnd || msgEnd < m_lastDmaIdx || (irq & AxiDma::IRQ_MEM_END)))
 	{
@@ -304,7 +1338,7 @@ void ZbntServer::handleInterrupt()
 			m_dmaReachedEnd = false;
 		}
 
-		if(clientAvailable())
+		if(clientAvailable() && m_streaming)
 		{
 			sendBytes(m_pendingDmaData);
 			sendBytes(buffer + m_lastDmaIdx, msgEnd - m_lastDmaIdx);
@@ -338,3 +1372,151 @@ void ZbntServer::pollTimer()
 		}
 	}
 }
+
+void ZbntServer::pollSubscriptions()
+{
+	if(!clientAvailable() || !m_helloReceived || m_loadingBitstream) return;
+
+	qint64 now = m_subscriptionClock.elapsed();
+	qint64 slack = m_subscriptionTimer->interval() / 2;
+
+	for(Subscription &sub : m_subscriptions)
+	{
+		if(now - sub.lastSample < sub.interval - slack) continue;
+
+		AbstractCore *core = findCore(sub.devID);
+		sub.lastSample = now;
+
+		if(!core) continue;
+
+		m_value.resize(0);
+
+		if(!core->getProperty(sub.propID, sub.params, m_value) || m_value == sub.lastValue)
+		{
+			continue;
+		}
+
+		// m_value is reused for every reply, keep a copy that doesn't share its buffer
+
+		sub.lastValue = QByteArray(m_value.constData(), m_value.size());
+
+		m_response.resize(0);
+		appendAsBytes<uint8_t>(m_response, sub.devID);
+		appendAsBytes<uint16_t>(m_response, sub.propID);
+		appendAsBytes<uint8_t>(m_response, true);
+		m_response.append(sub.params);
+		m_response.append(m_value);
+
+		sendMessage(MSG_ID_PROPERTY_CHANGED, m_response);
+	}
+}
+
+void ZbntServer::updateSubscriptionTimer()
+{
+	// Tick at the shortest requested interval, slower subscriptions are sampled on the ticks they're due
+
+	if(m_subscriptions.isEmpty())
+	{
+		m_subscriptionTimer->stop();
+		return;
+	}
+
+	int interval = m_subscriptions[0].interval;
+
+	for(const Subscription &sub : m_subscriptions)
+	{
+		interval = qMin<int>(interval, sub.interval);
+	}
+
+	if(!m_subscriptionTimer->isActive() || m_subscriptionTimer->interval() != interval)
+	{
+		m_subscriptionTimer->start(interval);
+	}
+}
+
+void ZbntServer::pollCounters()
+{
+	// Everything sent so far ends at a message boundary, partial messages
+	// at the end of the DMA buffer are kept in m_pendingDmaData until complete
+
+	if(!clientAvailable() || !m_isRunning || !m_streaming) return;
+
+	m_response.resize(0);
+	m_device->takeSnapshot(m_counterCores, m_response);
+
+	sendMessage(MSG_ID_COUNTER_RECORD, m_response);
+}
+
+void ZbntServer::commitStaged(QByteArray &response)
+{
+	// Configuration goes first in the order it was staged, enables are applied
+	// last in a single pass so all cores start and stop as close as possible
+
+	QVector<uint8_t> results(m_staged.size(), false);
+	QVector<int> enables;
+	QVector<AbstractCore*> cores(m_staged.size(), nullptr);
+	bool allOk = true;
+
+	for(int i = 0; i < m_staged.size(); ++i)
+	{
+		cores[i] = findCore(m_staged[i].devID);
+
+		if(!cores[i]) continue;
+
+		// A profile or a rate controller may have taken over the core after the write was staged
+
+		if(m_profile && m_profile->usesCore(m_staged[i].devID))
+		{
+			cores[i] = nullptr;
+			continue;
+		}
+
+		if(isRateControlled(m_staged[i].devID, m_staged[i].propID, m_staged[i].value))
+		{
+			cores[i] = nullptr;
+			continue;
+		}
+
+		if(m_staged[i].propID == PROP_ENABLE)
+		{
+			enables.append(i);
+			continue;
+		}
+
+		results[i] = applyProperty(cores[i], m_staged[i].propID, m_staged[i].value);
+	}
+
+	SimpleTimer *timer = m_device->timer();
+	QElapsedTimer hostTimer;
+	uint64_t timeStart = timer ? timer->getCurrentTime() : 0;
+	hostTimer.start();
+
+	for(int i : enables)
+	{
+		results[i] = cores[i]->setProperty(PROP_ENABLE, m_staged[i].value);
+	}
+
+	uint64_t hostTime = hostTimer.nsecsElapsed();
+	uint64_t timeEnd = timer ? timer->getCurrentTime() : 0;
+
+	// Reply: success, number of writes, skew in timer cycles and host nanoseconds, then (u8 core, u16 property, u8 success) per write
+
+	for(uint8_t ok : results)
+	{
+		allOk = allOk && ok;
+	}
+
+	appendAsBytes<uint8_t>(response, allOk);
+	appendAsBytes<uint16_t>(response, m_staged.size());
+	appendAsBytes<uint64_t>(response, timeEnd - timeStart);
+	appendAsBytes<uint64_t>(response, enables.size() ? hostTime : 0);
+
+	for(int i = 0; i < m_staged.size(); ++i)
+	{
+		appendAsBytes<uint8_t>(response, m_staged[i].devID);
+		appendAsBytes<uint16_t>(response, m_staged[i].propID);
+		appendAsBytes<uint8_t>(response, results[i]);
+	}
+
+	m_staged.clear();
+}
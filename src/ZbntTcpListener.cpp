@@ -0,0 +1,139 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <ZbntTcpListener.hpp>
+
+#include <unistd.h>
+
+#include <QNetworkInterface>
+
+#include <ZbntTcpServer.hpp>
+
+ZbntTcpListener::ZbntTcpListener(const QHostAddress &address, quint16 port, const QVector<AbstractDevice*> &devices)
+{
+	for(AbstractDevice *device : devices)
+	{
+		addSession(new ZbntTcpServer(device), device);
+	}
+
+	// Setup TCP socket
+
+	m_server = new QTcpServer(this);
+
+	if(address.isNull())
+		qFatal("[net] F: Invalid address requested");
+
+	if(!m_server->listen(address, port))
+		qFatal("[net] F: Can't listen on TCP port");
+
+	switch(address.protocol())
+	{
+		case QAbstractSocket::IPv4Protocol:
+		{
+			qInfo("[net] I: Listening on %s:%d", qUtf8Printable(address.toString()), m_server->serverPort());
+			break;
+		}
+
+		case QAbstractSocket::IPv6Protocol:
+		{
+			qInfo("[net] I: Listening on [%s]:%d", qUtf8Printable(address.toString()), m_server->serverPort());
+			break;
+		}
+
+		default:
+		{
+			qInfo("[net] I: Listening on port %d", m_server->serverPort());
+			break;
+		}
+	}
+
+	// Setup discovery servers
+
+	QString addressScope = address.scopeId();
+
+	for(const QNetworkInterface &iface : QNetworkInterface::allInterfaces())
+	{
+		if(addressScope.length() && iface.name() != addressScope)
+			continue;
+
+		if(!addressScope.length() && !(iface.flags() & QNetworkInterface::IsUp))
+			continue;
+
+		switch(iface.type())
+		{
+			case QNetworkInterface::Ethernet:
+			case QNetworkInterface::Wifi:
+			{
+				break;
+			}
+
+			default:
+			{
+				continue;
+			}
+		}
+
+		if(address != QHostAddress::Any && address != QHostAddress::AnyIPv4 && address != QHostAddress::AnyIPv6)
+		{
+			bool valid = false;
+
+			for(const QNetworkAddressEntry &ifaceAddr : iface.addressEntries())
+			{
+				if(address.isInSubnet(ifaceAddr.ip(), ifaceAddr.prefixLength()))
+				{
+					valid = true;
+					break;
+				}
+			}
+
+			if(!valid)
+				continue;
+		}
+
+		if(address.protocol() != QAbstractSocket::IPv6Protocol)
+		{
+			m_discoveryServers.append(new DiscoveryServer(iface, m_server->serverPort(), false, devices.size(), this));
+		}
+
+		if(address.protocol() != QAbstractSocket::IPv4Protocol)
+		{
+			m_discoveryServers.append(new DiscoveryServer(iface, m_server->serverPort(), true, devices.size(), this));
+		}
+	}
+
+	// Connect signals
+
+	connect(m_server, &QTcpServer::newConnection, this, &ZbntTcpListener::onIncomingConnection);
+}
+
+ZbntTcpListener::~ZbntTcpListener()
+{ }
+
+void ZbntTcpListener::onIncomingConnection()
+{
+	while(m_server->hasPendingConnections())
+	{
+		// The session takes over a duplicate of the descriptor, the socket itself stays here
+
+		QTcpSocket *connection = m_server->nextPendingConnection();
+		routeConnection(dup(connection->socketDescriptor()));
+
+		connection->abort();
+		connection->deleteLater();
+	}
+}
@@ -18,106 +18,40 @@
 
 #include <ZbntTcpServer.hpp>
 
-#include <QNetworkInterface>
-
 #include <MessageUtils.hpp>
 
-ZbntTcpServer::ZbntTcpServer(const QHostAddress &address, quint16 port, AbstractDevice *parent)
+ZbntTcpServer::ZbntTcpServer(AbstractDevice *parent)
 	: ZbntServer(parent)
-{
-	// Setup TCP socket
-
-	m_server = new QTcpServer(this);
+{ }
 
-	if(address.isNull())
-		qFatal("[net] F: Invalid address requested");
+ZbntTcpServer::~ZbntTcpServer()
+{ }
 
-	if(!m_server->listen(address, port))
-		qFatal("[net] F: Can't listen on TCP port");
+void ZbntTcpServer::acceptClient(qintptr fd, const QByteArray &pending)
+{
+	QTcpSocket *connection = new QTcpSocket(this);
+	connection->setSocketDescriptor(fd);
 
-	switch(address.protocol())
+	if(!m_client)
 	{
-		case QAbstractSocket::IPv4Protocol:
-		{
-			qInfo("[net] I: Listening on %s:%d", qUtf8Printable(address.toString()), m_server->serverPort());
-			break;
-		}
-
-		case QAbstractSocket::IPv6Protocol:
-		{
-			qInfo("[net] I: Listening on [%s]:%d", qUtf8Printable(address.toString()), m_server->serverPort());
-			break;
-		}
-
-		default:
-		{
-			qInfo("[net] I: Listening on port %d", m_server->serverPort());
-			break;
-		}
-	}
+		m_client = connection;
+		m_client->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
 
-	// Setup discovery servers
+		qInfo("[net] I: Incoming connection: %s", qUtf8Printable(m_client->peerAddress().toString()));
+		m_helloTimer->start();
 
-	QString addressScope = address.scopeId();
+		connect(m_client, &QTcpSocket::readyRead, this, &ZbntTcpServer::onReadyRead);
+		connect(m_client, &QTcpSocket::stateChanged, this, &ZbntTcpServer::onNetworkStateChanged);
 
-	for(const QNetworkInterface &iface : QNetworkInterface::allInterfaces())
+		handleIncomingData(pending);
+	}
+	else
 	{
-		if(addressScope.length() && iface.name() != addressScope)
-			continue;
-
-		if(!addressScope.length() && !(iface.flags() & QNetworkInterface::IsUp))
-			continue;
-
-		switch(iface.type())
-		{
-			case QNetworkInterface::Ethernet:
-			case QNetworkInterface::Wifi:
-			{
-				break;
-			}
-
-			default:
-			{
-				continue;
-			}
-		}
-
-		if(address != QHostAddress::Any && address != QHostAddress::AnyIPv4 && address != QHostAddress::AnyIPv6)
-		{
-			bool valid = false;
-
-			for(const QNetworkAddressEntry &ifaceAddr : iface.addressEntries())
-			{
-				if(address.isInSubnet(ifaceAddr.ip(), ifaceAddr.prefixLength()))
-				{
-					valid = true;
-					break;
-				}
-			}
-
-			if(!valid)
-				continue;
-		}
-
-		if(address.protocol() != QAbstractSocket::IPv6Protocol)
-		{
-			m_discoveryServers.append(new DiscoveryServer(iface, m_server->serverPort(), false, this));
-		}
-
-		if(address.protocol() != QAbstractSocket::IPv4Protocol)
-		{
-			m_discoveryServers.append(new DiscoveryServer(iface, m_server->serverPort(), true, this));
-		}
+		connection->abort();
+		connection->deleteLater();
 	}
-
-	// Connect signals
-
-	connect(m_server, &QTcpServer::newConnection, this, &ZbntTcpServer::onIncomingConnection);
 }
 
-ZbntTcpServer::~ZbntTcpServer()
-{ }
-
 bool ZbntTcpServer::clientAvailable() const
 {
 	return m_client != nullptr;
@@ -138,28 +72,6 @@ void ZbntTcpServer::sendMessage(MessageID id, const QByteArray &data)
 	writeMessage(m_client, id, data);
 }
 
-void ZbntTcpServer::onIncomingConnection()
-{
-	QTcpSocket *connection = m_server->nextPendingConnection();
-
-	if(!m_client)
-	{
-		m_client = connection;
-		m_client->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
-
-		qInfo("[net] I: Incoming connection: %s", qUtf8Printable(m_client->peerAddress().toString()));
-		m_helloTimer->start();
-
-		connect(m_client, &QTcpSocket::readyRead, this, &ZbntTcpServer::onReadyRead);
-		connect(m_client, &QTcpSocket::stateChanged, this, &ZbntTcpServer::onNetworkStateChanged);
-	}
-	else
-	{
-		connection->abort();
-		connection->deleteLater();
-	}
-}
-
 void ZbntTcpServer::onReadyRead()
 {
 	handleIncomingData(m_client->readAll());
@@ -186,6 +98,6 @@ void ZbntTcpServer::onNetworkStateChanged(QAbstractSocket::SocketState state)
 		m_client->deleteLater();
 		m_client = nullptr;
 
-		stopRun();
+		onClientDisconnected();
 	}
 }
@@ -0,0 +1,439 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <pthread.h>
+#include <time.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QThread>
+#include <QtEndian>
+
+#include <FdtUtils.hpp>
+#include <SimDevice.hpp>
+#include <Version.hpp>
+#include <ZbntLocalListener.hpp>
+#include <bench/BenchClient.hpp>
+#include <cores/StatsCollector.hpp>
+#include <cores/TrafficGenerator.hpp>
+
+// Byte by byte decoding used by readAsNumber before it switched to unaligned loads
+
+template<typename T>
+static T readBytewise(const QByteArray &data, quint32 offset)
+{
+	T res = 0;
+
+	for(uint32_t i = 0; i < sizeof(T); ++i)
+	{
+		res |= T(quint8(data[offset + i])) << (8 * i);
+	}
+
+	return res;
+}
+
+// Hand-written dispatch the stats collector used before its property table, kept as the baseline
+
+static bool switchSetProperty(volatile StatsCollector::Registers *regs, StatsCollector::Registers &shadow,
+                              PropertyID propID, const QByteArray &value)
+{
+	switch(propID)
+	{
+		case PROP_ENABLE:
+		{
+			if(value.length() < 1) return false;
+
+			shadow.config = (shadow.config & ~StatsCollector::CFG_ENABLE) | (readBytewise<uint8_t>(value, 0) & StatsCollector::CFG_ENABLE);
+			regs->config = shadow.config;
+			break;
+		}
+
+		case PROP_ENABLE_LOG:
+		{
+			if(value.length() < 1) return false;
+
+			if(readBytewise<uint8_t>(value, 0))
+			{
+				shadow.config |= StatsCollector::CFG_LOG_ENABLE;
+			}
+			else
+			{
+				shadow.config &= ~StatsCollector::CFG_LOG_ENABLE;
+			}
+
+			regs->config = shadow.config;
+			break;
+		}
+
+		case PROP_SAMPLE_PERIOD:
+		{
+			if(value.length() < 4) return false;
+
+			regs->sample_period = shadow.sample_period = readBytewise<uint32_t>(value, 0);
+			break;
+		}
+
+		case PROP_OVERFLOW_COUNT:
+		{
+			// read-only
+			break;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool switchGetProperty(volatile StatsCollector::Registers *regs, const StatsCollector::Registers &shadow,
+                              PropertyID propID, QByteArray &value)
+{
+	switch(propID)
+	{
+		case PROP_ENABLE:
+		{
+			appendAsBytes<uint8_t>(value, shadow.config & StatsCollector::CFG_ENABLE);
+			break;
+		}
+
+		case PROP_ENABLE_LOG:
+		{
+			appendAsBytes<uint8_t>(value, !!(shadow.config & StatsCollector::CFG_LOG_ENABLE));
+			break;
+		}
+
+		case PROP_SAMPLE_PERIOD:
+		{
+			appendAsBytes(value, shadow.sample_period);
+			break;
+		}
+
+		case PROP_OVERFLOW_COUNT:
+		{
+			appendAsBytes<uint64_t>(value, regs->overflow_count);
+			break;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Full rewrites used by template and script uploads before they compared against the host copy,
+// writing one byte or word at a time to a block of host memory laid out like the core
+
+static bool fullTemplateWrite(volatile uint8_t *mem, const QByteArray &value)
+{
+	int nameLen = value.indexOf('\0');
+	int templateLen = (value.length() - nameLen - 1) / 2;
+
+	if(nameLen <= 0 || templateLen <= 0) return false;
+
+	const char *srcA = value.constData() + nameLen + 1;
+	const char *srcB = srcA + templateLen;
+
+	volatile uint8_t *dstA = mem + TGEN_MEM_TEMPLATE_OFFSET;
+	volatile uint8_t *dstB = mem + TGEN_MEM_SOURCE_OFFSET;
+
+	for(int i = 0; i < TGEN_MEM_SIZE; ++i)
+	{
+		if(i < templateLen)
+		{
+			dstA[i] = srcA[i];
+			dstB[i] = srcB[i];
+		}
+		else
+		{
+			dstA[i] = 0x00;
+			dstB[i] = 0x01;
+		}
+	}
+
+	return true;
+}
+
+static bool fullScriptWrite(volatile uint32_t *mem, int words, const QByteArray &value)
+{
+	int nameLen = value.indexOf('\0', 4) - 4;
+
+	if(nameLen <= 0) return false;
+
+	for(int i = 0, j = nameLen + 5; i < words; ++i, j += 4)
+	{
+		mem[i] = (j < value.length()) ? readBytewise<uint32_t>(value, j) : 0;
+	}
+
+	return true;
+}
+
+static QJsonObject runMicrobenchmarks(const SimDevice &dev, int iterations)
+{
+	AbstractCore *stats = nullptr;
+	AbstractCore *generator = nullptr;
+	AbstractCore *detector = nullptr;
+
+	for(AbstractCore *core : dev.coreList())
+	{
+		switch(core->getType())
+		{
+			case DEV_STATS_COLLECTOR: if(!stats) stats = core; break;
+			case DEV_TRAFFIC_GENERATOR: if(!generator) generator = core; break;
+			case DEV_FRAME_DETECTOR: if(!detector) detector = core; break;
+			default: break;
+		}
+	}
+
+	// Average time per call, in nanoseconds
+
+	auto measure = [iterations](auto op)
+	{
+		QElapsedTimer timer;
+		timer.start();
+
+		for(int i = 0; i < iterations; ++i)
+		{
+			op(i);
+		}
+
+		return double(timer.nsecsElapsed()) / iterations;
+	};
+
+	QJsonObject results;
+	results["iterations"] = iterations;
+
+	// Table-driven property access
+
+	QByteArray period("\x10\x27\x00\x00", 4);
+	QByteArray value;
+	value.reserve(64);
+
+	results["property_set_ns"] = measure([&](int) { stats->setProperty(PROP_SAMPLE_PERIOD, period); });
+	results["property_get_ns"] = measure([&](int) { value.resize(0); stats->getProperty(PROP_SAMPLE_PERIOD, QByteArray(), value); });
+
+	// Same operations through a switch over a register block in host memory
+
+	StatsCollector::Registers switchRegs = {}, switchShadow = {};
+	volatile StatsCollector::Registers *switchRegsPtr = &switchRegs;
+
+	results["property_set_switch_ns"] = measure([&](int) { switchSetProperty(switchRegsPtr, switchShadow, PROP_SAMPLE_PERIOD, period); });
+	results["property_get_switch_ns"] = measure([&](int) { value.resize(0); switchGetProperty(switchRegsPtr, switchShadow, PROP_SAMPLE_PERIOD, value); });
+
+	// Decoding a GET_PROPERTY request and encoding its reply, first with copies and fresh buffers
+	// as the server used to, then with views and reused buffers as it does now
+
+	QByteArray request;
+	appendAsBytes<uint8_t>(request, 0);
+	appendAsBytes<uint16_t>(request, PROP_SAMPLE_PERIOD);
+
+	QByteArray response;
+	response.reserve(64);
+
+	results["control_copy_ns"] = measure([&](int)
+	{
+		uint8_t devID = request[0];
+		PropertyID propID = PropertyID(readBytewise<uint16_t>(request, 1));
+		QByteArray params = request.mid(3);
+		QByteArray result;
+
+		bool ok = stats->getProperty(propID, params, result);
+
+		QByteArray reply;
+		appendAsBytes<uint8_t>(reply, devID);
+		appendAsBytes<uint16_t>(reply, propID);
+		appendAsBytes<uint8_t>(reply, ok);
+		reply.append(params);
+		reply.append(result);
+	});
+
+	results["control_view_ns"] = measure([&](int)
+	{
+		uint8_t devID = request[0];
+		PropertyID propID = PropertyID(qFromLittleEndian<uint16_t>(request.constData() + 1));
+		QByteArray params = QByteArray::fromRawData(request.constData() + 3, request.length() - 3);
+
+		value.resize(0);
+		bool ok = stats->getProperty(propID, params, value);
+
+		response.resize(0);
+		appendAsBytes<uint8_t>(response, devID);
+		appendAsBytes<uint16_t>(response, propID);
+		appendAsBytes<uint8_t>(response, ok);
+		response.append(params);
+		response.append(value);
+	});
+
+	// Template uploads, unchanged contents only compare against the host copy
+
+	QByteArray templateA("bench", 6);
+	templateA.append(QByteArray(1514, 0x55));
+	templateA.append(QByteArray(1514, 0x00));
+
+	QByteArray templateB = templateA;
+	templateB[6 + 100] = 0x66;
+
+	QByteArray templateC("bench", 6);
+	templateC.append(QByteArray(1514, 0xAA));
+	templateC.append(QByteArray(1514, 0x01));
+
+	QByteArray templates[] = {templateA, templateB};
+	QByteArray templatesFull[] = {templateA, templateC};
+
+	results["template_same_ns"] = measure([&](int) { generator->setProperty(PROP_FRAME_TEMPLATE, templateA); });
+	results["template_changed_ns"] = measure([&](int i) { generator->setProperty(PROP_FRAME_TEMPLATE, templates[i & 1]); });
+	results["template_all_changed_ns"] = measure([&](int i) { generator->setProperty(PROP_FRAME_TEMPLATE, templatesFull[i & 1]); });
+
+	// Baseline, every upload rewrites the whole template memory byte by byte
+
+	QVector<uint8_t> templateMem(TGEN_MEM_SOURCE_OFFSET + TGEN_MEM_SIZE, 0);
+	volatile uint8_t *templateMemPtr = templateMem.data();
+
+	results["template_full_write_ns"] = measure([&](int i) { fullTemplateWrite(templateMemPtr, templatesFull[i & 1]); });
+
+	// Script uploads
+
+	if(detector)
+	{
+		QByteArray scriptA(4, 0x00);
+		scriptA.append("bench", 6);
+		scriptA.append(QByteArray(128 * 4, 0x11));
+
+		QByteArray scriptB = scriptA;
+		scriptB[10 + 64] = 0x22;
+
+		QByteArray scriptC(4, 0x00);
+		scriptC.append("bench", 6);
+		scriptC.append(QByteArray(128 * 4, 0x33));
+
+		QByteArray scripts[] = {scriptA, scriptB};
+		QByteArray scriptsFull[] = {scriptA, scriptC};
+
+		results["script_same_ns"] = measure([&](int) { detector->setProperty(PROP_FRAME_SCRIPT, scriptA); });
+		results["script_changed_ns"] = measure([&](int i) { detector->setProperty(PROP_FRAME_SCRIPT, scripts[i & 1]); });
+		results["script_all_changed_ns"] = measure([&](int i) { detector->setProperty(PROP_FRAME_SCRIPT, scriptsFull[i & 1]); });
+
+		// Baseline, every upload rewrites the whole slot one word at a time
+
+		QVector<uint32_t> scriptMem(128, 0);
+		volatile uint32_t *scriptMemPtr = scriptMem.data();
+
+		results["script_full_write_ns"] = measure([&](int i) { fullScriptWrite(scriptMemPtr, scriptMem.size(), scriptsFull[i & 1]); });
+	}
+
+	return results;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("zbnt_bench");
+	QCoreApplication::setApplicationVersion(ZBNT_VERSION);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Runs the server against a simulated device and prints the results as JSON");
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.addOptions({
+		{"duration", "Length of the streaming run, in seconds.", "seconds", "10"},
+		{"ports", "Number of simulated ports.", "ports", "4"},
+		{"sample-period", "Stats collector sample period, in clock cycles.", "cycles", "12500"},
+		{"detector-rate", "Frame detector matches per second.", "rate", "10000"},
+		{"pipeline", "Tagged requests kept in flight.", "count", "32"},
+		{"tagged", "Number of tagged requests to send.", "count", "100000"},
+		{"send-delay", "Delay added to each tagged request, in milliseconds.", "ms", "0"},
+		{"iterations", "Iterations of each microbenchmark.", "count", "100000"}
+	});
+
+	parser.process(app);
+
+	BenchConfig config;
+	config.duration = qMax(1, parser.value("duration").toInt());
+	config.ports = parser.value("ports").toInt();
+	config.samplePeriod = parser.value("sample-period").toUInt();
+	config.detectorRate = parser.value("detector-rate").toUInt();
+	config.pipeline = qMax(1, parser.value("pipeline").toInt());
+	config.taggedRequests = qMax(1, parser.value("tagged").toInt());
+	config.sendDelay = qMax(0, parser.value("send-delay").toInt());
+	config.serverClock = CLOCK_THREAD_CPUTIME_ID;
+
+	int iterations = qMax(1, parser.value("iterations").toInt());
+
+	SimDevice dev(config.ports, config.detectorRate);
+
+	QJsonObject configJson;
+	configJson["duration"] = config.duration;
+	configJson["ports"] = config.ports;
+	configJson["sample_period"] = double(config.samplePeriod);
+	configJson["detector_rate"] = double(config.detectorRate);
+
+	QJsonObject results;
+	results["version"] = ZBNT_VERSION;
+	results["config"] = configJson;
+	results["micro"] = runMicrobenchmarks(dev, iterations);
+
+	// Sessions run in threads of the listener, the consumer gets its own thread like a separate process would
+
+	ZbntLocalListener server("zbnt-bench", {&dev});
+	QThread clientThread;
+
+	// CPU usage is read from the clock of the thread serving the device
+
+	QMetaObject::invokeMethod(server.session(0),
+		[&config]()
+		{
+			pthread_getcpuclockid(pthread_self(), &config.serverClock);
+		},
+		Qt::BlockingQueuedConnection
+	);
+
+	BenchClient *client = new BenchClient(config,
+		[&app]()
+		{
+			QMetaObject::invokeMethod(&app, []() { QCoreApplication::quit(); }, Qt::QueuedConnection);
+		}
+	);
+
+	client->moveToThread(&clientThread);
+	clientThread.start();
+
+	QMetaObject::invokeMethod(client, [client]() { client->start(); }, Qt::QueuedConnection);
+
+	app.exec();
+
+	clientThread.quit();
+	clientThread.wait();
+
+	for(auto it = client->results().constBegin(); it != client->results().constEnd(); ++it)
+	{
+		results[it.key()] = it.value();
+	}
+
+	delete client;
+
+	fputs(QJsonDocument(results).toJson().constData(), stdout);
+	return 0;
+}
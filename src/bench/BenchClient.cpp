@@ -0,0 +1,364 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <bench/BenchClient.hpp>
+
+#include <algorithm>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <QCoreApplication>
+#include <QtEndian>
+
+#include <MessageUtils.hpp>
+
+static double processCpuTime()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static double threadCpuTime(clockid_t clock)
+{
+	timespec ts;
+
+	if(clock_gettime(clock, &ts) == -1) return 0;
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+BenchClient::BenchClient(const BenchConfig &config, const BenchDoneCallback &callback)
+	: m_config(config), m_callback(callback)
+{
+	m_offsets.reserve(MAX_SAMPLES);
+	m_controlRtt.reserve(config.duration * 1000 / CONTROL_INTERVAL);
+}
+
+BenchClient::~BenchClient()
+{ }
+
+void BenchClient::start()
+{
+	// The local server listens on an abstract socket, QLocalSocket can't connect to those by name
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if(sock == -1)
+	{
+		qFatal("[bench] F: Can't create local socket");
+	}
+
+	sockaddr_un sockAddr;
+	memset(&sockAddr, 0, sizeof(sockAddr));
+	snprintf(sockAddr.sun_path + 1, sizeof(sockAddr.sun_path) - 1, "/tmp/zbnt-local-%016llX", QCoreApplication::applicationPid());
+	sockAddr.sun_family = AF_UNIX;
+
+	if(::connect(sock, (sockaddr*) &sockAddr, sizeof(sa_family_t) + 33) == -1)
+	{
+		qFatal("[bench] F: Can't connect to local server");
+	}
+
+	m_socket = new QLocalSocket(this);
+	m_socket->setSocketDescriptor(sock);
+
+	m_controlTimer = new QTimer(this);
+	m_controlTimer->setInterval(CONTROL_INTERVAL);
+
+	connect(m_socket, &QLocalSocket::readyRead, this, &BenchClient::onReadyRead);
+	connect(m_controlTimer, &QTimer::timeout, this, &BenchClient::sendControlRequest);
+
+	m_clock.start();
+	writeMessage(m_socket, MSG_ID_HELLO, QByteArray());
+}
+
+const QJsonObject &BenchClient::results() const
+{
+	return m_results;
+}
+
+void BenchClient::onReadyRead()
+{
+	QByteArray data = m_socket->readAll();
+
+	if(m_phase == PHASE_STREAMING || m_phase == PHASE_DRAINING)
+	{
+		m_streamBytes += data.size();
+	}
+
+	handleIncomingData(data);
+}
+
+void BenchClient::onMessageReceived(quint16 id, const QByteArray &data)
+{
+	qint64 now = m_clock.nsecsElapsed();
+
+	if((id & MSG_ID_MEASUREMENT) == MSG_ID_MEASUREMENT)
+	{
+		if(data.size() < 8) return;
+
+		// Messages carry the timer value at which they were generated, the offset to the local
+		// clock only varies with the delivery latency
+
+		uint64_t time = qFromLittleEndian<uint64_t>(data.constData());
+
+		if(m_offsets.size() < MAX_SAMPLES)
+		{
+			m_offsets.append(now - time * NS_PER_CYCLE);
+		}
+
+		if(m_firstMessage < 0)
+		{
+			m_firstMessage = now;
+		}
+
+		m_lastMessage = now;
+		m_messages++;
+		return;
+	}
+
+	switch(id)
+	{
+		case MSG_ID_HELLO:
+		{
+			startStreaming();
+			break;
+		}
+
+		case MSG_ID_GET_PROPERTY:
+		{
+			if(data.size() < 3 || uint8_t(data[0]) != 0xFF || m_controlSent < 0) break;
+			if(qFromLittleEndian<uint16_t>(data.constData() + 1) != PROP_TIMER_TIME) break;
+
+			m_controlRtt.append(now - m_controlSent);
+			m_controlSent = -1;
+			break;
+		}
+
+		case MSG_ID_RUN_STOP:
+		{
+			if(m_phase != PHASE_DRAINING) break;
+
+			m_cpuEnd = threadCpuTime(m_config.serverClock);
+			m_processCpuEnd = processCpuTime();
+			m_phase = PHASE_TAGGED;
+			m_taggedStart = now;
+
+			for(int i = 0; i < m_config.pipeline; ++i)
+			{
+				sendTaggedRequest();
+			}
+
+			break;
+		}
+
+		case MSG_ID_TAGGED_RESPONSE:
+		{
+			if(m_phase != PHASE_TAGGED) break;
+
+			if(++m_taggedDone == m_config.taggedRequests)
+			{
+				m_taggedEnd = now;
+				finish();
+			}
+			else
+			{
+				sendTaggedRequest();
+			}
+
+			break;
+		}
+
+		default:
+		{
+			break;
+		}
+	}
+}
+
+void BenchClient::setProperty(uint8_t devID, PropertyID propID, uint64_t value, int size)
+{
+	QByteArray message;
+	appendAsBytes<uint8_t>(message, devID);
+	appendAsBytes<uint16_t>(message, propID);
+	message.append((const char*) &value, size);
+
+	writeMessage(m_socket, MSG_ID_SET_PROPERTY, message);
+}
+
+void BenchClient::startStreaming()
+{
+	// Core indexes follow the layout generated by SimDevice
+
+	for(int i = 0; i < m_config.ports; ++i)
+	{
+		setProperty(2 * i, PROP_ENABLE, 1, 1);
+		setProperty(2 * i + 1, PROP_SAMPLE_PERIOD, m_config.samplePeriod, 4);
+	}
+
+	int latencyID = 2 * m_config.ports;
+
+	setProperty(latencyID, PROP_ENABLE, 1, 1);
+	setProperty(latencyID, PROP_ENABLE_LOG, 1, 1);
+
+	if(m_config.ports >= 4)
+	{
+		setProperty(latencyID + 1, PROP_ENABLE_SCRIPT, 1, 4);
+	}
+
+	// The run is stopped by the client, leave some margin in the timer
+
+	setProperty(0xFF, PROP_TIMER_LIMIT, (m_config.duration + 10) * 125'000'000ull, 8);
+	writeMessage(m_socket, MSG_ID_RUN_START, QByteArray());
+	setProperty(0xFF, PROP_ENABLE, 1, 1);
+
+	m_phase = PHASE_STREAMING;
+	m_cpuStart = threadCpuTime(m_config.serverClock);
+	m_processCpuStart = processCpuTime();
+	m_controlTimer->start();
+
+	QTimer::singleShot(m_config.duration * 1000, this, &BenchClient::stopStreaming);
+}
+
+void BenchClient::stopStreaming()
+{
+	m_controlTimer->stop();
+	m_phase = PHASE_DRAINING;
+
+	writeMessage(m_socket, MSG_ID_RUN_STOP, QByteArray());
+}
+
+void BenchClient::sendControlRequest()
+{
+	// Only one request in flight, so the round-trip isn't inflated by queueing on our side
+
+	if(m_controlSent >= 0) return;
+
+	QByteArray message;
+	appendAsBytes<uint8_t>(message, 0xFF);
+	appendAsBytes<uint16_t>(message, PROP_TIMER_TIME);
+
+	m_controlSent = m_clock.nsecsElapsed();
+	writeMessage(m_socket, MSG_ID_GET_PROPERTY, message);
+}
+
+void BenchClient::sendTaggedRequest()
+{
+	if(m_taggedSent >= m_config.taggedRequests) return;
+
+	QByteArray message;
+	appendAsBytes<uint32_t>(message, m_taggedSent++);
+	appendAsBytes<uint16_t>(message, MSG_ID_GET_PROPERTY);
+	appendAsBytes<uint8_t>(message, 1);
+	appendAsBytes<uint16_t>(message, PROP_SAMPLE_PERIOD);
+
+	sendDelayed(MSG_ID_TAGGED_REQUEST, message);
+}
+
+void BenchClient::sendDelayed(MessageID id, const QByteArray &data)
+{
+	// Simulates a high-latency link, every request reaches the server sendDelay milliseconds late
+
+	if(m_config.sendDelay <= 0)
+	{
+		writeMessage(m_socket, id, data);
+		return;
+	}
+
+	QTimer::singleShot(m_config.sendDelay, Qt::PreciseTimer, this, [this, id, data]() { writeMessage(m_socket, id, data); });
+}
+
+void BenchClient::finish()
+{
+	m_phase = PHASE_DONE;
+
+	double streamTime = m_lastMessage > m_firstMessage ? (m_lastMessage - m_firstMessage) / 1e9 : 0;
+	double cpu = m_cpuEnd - m_cpuStart;
+	double taggedTime = (m_taggedEnd - m_taggedStart) / 1e9;
+
+	// Latencies are relative to the fastest message, the clocks of the timer and the host aren't aligned
+
+	if(!m_offsets.isEmpty())
+	{
+		qint64 minOffset = *std::min_element(m_offsets.constBegin(), m_offsets.constEnd());
+
+		for(qint64 &offset : m_offsets)
+		{
+			offset -= minOffset;
+		}
+	}
+
+	QJsonObject stream;
+	stream["bytes"] = double(m_streamBytes);
+	stream["messages"] = double(m_messages);
+	stream["seconds"] = streamTime;
+	stream["mb_per_s"] = streamTime > 0 ? m_streamBytes / streamTime / 1e6 : 0;
+	stream["messages_per_s"] = streamTime > 0 ? m_messages / streamTime : 0;
+
+	// Only the thread serving the device is counted, the process total also includes this client
+
+	QJsonObject cpuUsage;
+	cpuUsage["seconds"] = cpu;
+	cpuUsage["seconds_per_gb"] = m_streamBytes ? cpu / (m_streamBytes / 1e9) : 0;
+	cpuUsage["process_seconds"] = m_processCpuEnd - m_processCpuStart;
+
+	QJsonObject tagged;
+	tagged["requests"] = m_config.taggedRequests;
+	tagged["pipeline"] = m_config.pipeline;
+	tagged["send_delay_ms"] = m_config.sendDelay;
+	tagged["ops_per_s"] = taggedTime > 0 ? m_config.taggedRequests / taggedTime : 0;
+
+	m_results["stream"] = stream;
+	m_results["delivery_latency_us"] = percentiles(m_offsets, 1e-3);
+	m_results["control_rtt_us"] = percentiles(m_controlRtt, 1e-3);
+	m_results["cpu"] = cpuUsage;
+	m_results["tagged_requests"] = tagged;
+
+	m_socket->disconnectFromServer();
+
+	if(m_callback)
+	{
+		m_callback();
+	}
+}
+
+QJsonObject BenchClient::percentiles(QVector<qint64> &samples, double scale)
+{
+	QJsonObject result;
+	result["samples"] = samples.size();
+
+	if(samples.isEmpty()) return result;
+
+	std::sort(samples.begin(), samples.end());
+
+	auto at = [&](double p)
+	{
+		return samples[qMin<int>(samples.size() - 1, p * samples.size())] * scale;
+	};
+
+	result["p50"] = at(0.5);
+	result["p90"] = at(0.9);
+	result["p99"] = at(0.99);
+	result["p999"] = at(0.999);
+	result["max"] = samples.last() * scale;
+
+	return result;
+}
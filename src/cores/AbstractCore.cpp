@@ -19,6 +19,7 @@
 #include <cores/AbstractCore.hpp>
 
 #include <AbstractDevice.hpp>
+#include <FdtUtils.hpp>
 #include <cores/AxiDma.hpp>
 #include <cores/AxiMdio.hpp>
 #include <cores/FrameDetector.hpp>
@@ -74,3 +75,207 @@ uint64_t AbstractCore::getPorts() const
 {
 	return 0;
 }
+
+bool AbstractCore::isAsyncProperty(PropertyID propID) const
+{
+	Q_UNUSED(propID);
+	return false;
+}
+
+void AbstractCore::setPropertyAsync(PropertyID propID, const QByteArray &value, QObject *context, const PropertyCallback &callback)
+{
+	Q_UNUSED(context);
+
+	callback(setProperty(propID, value), value);
+}
+
+void AbstractCore::getPropertyAsync(PropertyID propID, const QByteArray &params, QObject *context, const PropertyCallback &callback)
+{
+	Q_UNUSED(context);
+
+	QByteArray value;
+	bool ok = getProperty(propID, params, value);
+
+	callback(ok, value);
+}
+
+void AbstractCore::syncRegisters()
+{ }
+
+bool AbstractCore::setHold(bool hold)
+{
+	Q_UNUSED(hold);
+	return false;
+}
+
+bool AbstractCore::getSnapshot(QByteArray &output)
+{
+	Q_UNUSED(output);
+	return false;
+}
+
+bool AbstractCore::setPropertyBulk(const QByteArray &value)
+{
+	// List of (u16 property, u16 length, value) entries, applied in order
+
+	bool ok = true;
+
+	for(int i = 0; i + 4 <= value.length();)
+	{
+		PropertyID propID = PropertyID(readAsNumber<uint16_t>(value, i));
+		uint16_t length = readAsNumber<uint16_t>(value, i + 2);
+
+		if(i + 4 + length > value.length()) return false;
+		if(propID == PROP_BULK) return false;
+
+		ok = setProperty(propID, value.mid(i + 4, length)) && ok;
+		i += 4 + length;
+	}
+
+	return ok;
+}
+
+bool AbstractCore::getPropertyBulk(const QByteArray &params, QByteArray &value)
+{
+	// List of (u16 property, u16 length, params) entries, each answered with
+	// (u16 property, u8 success, u16 length, value)
+
+	for(int i = 0; i + 4 <= params.length();)
+	{
+		PropertyID propID = PropertyID(readAsNumber<uint16_t>(params, i));
+		uint16_t length = readAsNumber<uint16_t>(params, i + 2);
+
+		if(i + 4 + length > params.length()) return false;
+		if(propID == PROP_BULK) return false;
+
+		QByteArray propValue;
+		bool ok = getProperty(propID, params.mid(i + 4, length), propValue);
+
+		appendAsBytes<uint16_t>(value, propID);
+		appendAsBytes<uint8_t>(value, ok);
+		appendAsBytes<uint16_t>(value, propValue.length());
+		value.append(propValue);
+
+		i += 4 + length;
+	}
+
+	return true;
+}
+
+static uint64_t loadField(const volatile void *base, uint16_t offset, uint8_t width)
+{
+	switch(width)
+	{
+		case 1: return *makePointer<const volatile uint8_t>(base, offset);
+		case 2: return *makePointer<const volatile uint16_t>(base, offset);
+		case 4: return *makePointer<const volatile uint32_t>(base, offset);
+		case 8: return *makePointer<const volatile uint64_t>(base, offset);
+	}
+
+	return 0;
+}
+
+static void storeField(volatile void *base, uint16_t offset, uint8_t width, uint64_t value)
+{
+	switch(width)
+	{
+		case 1: *makePointer<volatile uint8_t>(base, offset) = value; break;
+		case 2: *makePointer<volatile uint16_t>(base, offset) = value; break;
+		case 4: *makePointer<volatile uint32_t>(base, offset) = value; break;
+		case 8: *makePointer<volatile uint64_t>(base, offset) = value; break;
+	}
+}
+
+const PropertyDescriptor *AbstractCore::findProperty(PropertyID propID) const
+{
+	// Tables have a handful of entries, a scan is cheaper than hashing
+
+	for(size_t i = 0; i < m_propCount; ++i)
+	{
+		if(m_propTable[i].id == propID)
+		{
+			return &m_propTable[i];
+		}
+	}
+
+	return nullptr;
+}
+
+bool AbstractCore::writeProperty(const PropertyDescriptor &desc, const QByteArray &value)
+{
+	// Writes to read-only properties are accepted and ignored
+
+	if(!(desc.flags & PropertyDescriptor::FLAG_WRITE)) return true;
+	if(value.length() < desc.wireWidth) return false;
+
+	uint64_t number = 0;
+
+	for(int i = 0; i < desc.wireWidth; ++i)
+	{
+		number |= uint64_t(quint8(value[i])) << (8 * i);
+	}
+
+	if(number < desc.minValue) return false;
+	if(desc.maxValue && number > desc.maxValue) return false;
+
+	uint64_t reg = number;
+
+	if(desc.mask)
+	{
+		if(desc.flags & PropertyDescriptor::FLAG_BOOL)
+		{
+			number = number ? desc.mask : 0;
+		}
+		else
+		{
+			number = (number << __builtin_ctzll(desc.mask)) & desc.mask;
+		}
+
+		reg = (loadField(m_propShadow, desc.offset, desc.regWidth) & ~desc.mask) | number;
+	}
+
+	storeField(m_propShadow, desc.offset, desc.regWidth, reg);
+	storeField(m_propRegs, desc.offset, desc.regWidth, reg);
+	return true;
+}
+
+void AbstractCore::readProperty(const PropertyDescriptor &desc, QByteArray &value) const
+{
+	const volatile void *src = (desc.flags & PropertyDescriptor::FLAG_LIVE) ? m_propRegs : m_propShadow;
+	uint64_t number = loadField(src, desc.offset, desc.regWidth);
+
+	if(desc.mask)
+	{
+		if(desc.flags & PropertyDescriptor::FLAG_BOOL)
+		{
+			number = !!(number & desc.mask);
+		}
+		else
+		{
+			number = (number & desc.mask) >> __builtin_ctzll(desc.mask);
+		}
+	}
+
+	value.append((const char*) &number, desc.wireWidth);
+}
+
+void AbstractCore::announceProperties(QByteArray &output, int start) const
+{
+	// Describe the table as (u16 property, u8 width, u8 access) entries and update
+	// the size of the block that starts at the given position
+
+	uint16_t length = 4 * m_propCount;
+
+	appendAsBytes<uint16_t>(output, PROP_PROPERTY_TABLE);
+	appendAsBytes<uint16_t>(output, length);
+
+	for(size_t i = 0; i < m_propCount; ++i)
+	{
+		appendAsBytes<uint16_t>(output, m_propTable[i].id);
+		appendAsBytes<uint8_t>(output, m_propTable[i].wireWidth);
+		appendAsBytes<uint8_t>(output, m_propTable[i].flags & PropertyDescriptor::FLAG_RW);
+	}
+
+	uint16_t size = readAsNumber<uint16_t>(output, start + 2) + 4 + length;
+	memcpy(output.data() + start + 2, &size, sizeof(uint16_t));
+}
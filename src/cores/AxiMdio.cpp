@@ -19,6 +19,7 @@
 #include <cores/AxiMdio.hpp>
 
 #include <QDebug>
+#include <QElapsedTimer>
 
 #include <AbstractDevice.hpp>
 #include <FdtUtils.hpp>
@@ -32,10 +33,15 @@ AxiMdio::AxiMdio(const QString &name, uint32_t id, void *regs, const QList<uint8
 	{
 		qInfo("           - Port %d, phy address %02X", ports[i], phys[i]);
 	}
+
+	m_worker = new MdioThread(this);
+	m_worker->start();
 }
 
 AxiMdio::~AxiMdio()
-{ }
+{
+	delete m_worker;
+}
 
 AbstractCore *AxiMdio::createCore(AbstractDevice *parent, const QString &name, uint32_t id,
                                   void *regs, const void *fdt, int offset)
@@ -105,27 +111,28 @@ AbstractCore *AxiMdio::createCore(AbstractDevice *parent, const QString &name, u
 
 	if(initSeq)
 	{
+		MdioBatch batch;
+
 		while(length >= 12)
 		{
 			uint32_t phyAddr, regAddr, value;
 
-			if(fdtArrayToVars(initSeq, length, phyAddr, regAddr, value))
+			if(fdtArrayToVars(initSeq, length, phyAddr, regAddr, value) && phyAddr <= 31)
 			{
-				if(phyAddr > 31) continue;
+				// Registers above 31 are accessed through the indirect registers, using the vendor-specific MMD
 
-				if(regAddr > 31)
-				{
-					core->writePhyIndirect(phyAddr, regAddr, value);
-				}
-				else
-				{
-					core->writePhy(phyAddr, regAddr, value);
-				}
+				uint8_t devAddr = (regAddr > 31) ? 0x1F : 0;
+				batch.append({MdioTransaction::OP_WRITE, uint8_t(phyAddr), devAddr, uint16_t(regAddr), uint16_t(value)});
 			}
 
 			length -= 12;
 			initSeq += 12;
 		}
+
+		if(!core->execute(batch))
+		{
+			qWarning("[core] W: Failed to apply zbnt,init-seq");
+		}
 	}
 
 	return core;
@@ -159,39 +166,106 @@ DeviceType AxiMdio::getType() const
 	return DEV_AXI_MDIO;
 }
 
-uint32_t AxiMdio::readPhy(uint32_t phyAddr, uint32_t regAddr)
+bool AxiMdio::readPhy(uint32_t phyAddr, uint32_t regAddr, uint16_t &value)
 {
 	m_regs->addr = OP_READ | (phyAddr << 5) | regAddr;
 	m_regs->ctl = CTL_ENABLE | CTL_START;
 
-	while(m_regs->ctl & CTL_START);
+	if(!waitForIdle())
+	{
+		return false;
+	}
 
-	return m_regs->rd_data;
+	value = m_regs->rd_data;
+	return true;
 }
 
-uint32_t AxiMdio::readPhyIndirect(uint32_t phyAddr, uint32_t regAddr)
+bool AxiMdio::readPhyIndirect(uint32_t phyAddr, uint32_t devAddr, uint32_t regAddr, uint16_t &value)
 {
-	writePhy(phyAddr, 0x0D, 0x001F);
-	writePhy(phyAddr, 0x0E, regAddr);
-	writePhy(phyAddr, 0x0D, 0x401F);
-	return readPhy(phyAddr, 0x0E);
+	return writePhy(phyAddr, 0x0D, devAddr)
+	    && writePhy(phyAddr, 0x0E, regAddr)
+	    && writePhy(phyAddr, 0x0D, 0x4000 | devAddr)
+	    && readPhy(phyAddr, 0x0E, value);
 }
 
-void AxiMdio::writePhy(uint32_t phyAddr, uint32_t regAddr, uint32_t value)
+bool AxiMdio::writePhy(uint32_t phyAddr, uint32_t regAddr, uint16_t value)
 {
 	m_regs->addr = (phyAddr << 5) | regAddr;
 	m_regs->wr_data = value;
 	m_regs->ctl = CTL_ENABLE | CTL_START;
 
-	while(m_regs->ctl & CTL_START);
+	return waitForIdle();
 }
 
-void AxiMdio::writePhyIndirect(uint32_t phyAddr, uint32_t regAddr, uint32_t value)
+bool AxiMdio::writePhyIndirect(uint32_t phyAddr, uint32_t devAddr, uint32_t regAddr, uint16_t value)
 {
-	writePhy(phyAddr, 0x0D, 0x001F);
-	writePhy(phyAddr, 0x0E, regAddr);
-	writePhy(phyAddr, 0x0D, 0x401F);
-	writePhy(phyAddr, 0x0E, value);
+	return writePhy(phyAddr, 0x0D, devAddr)
+	    && writePhy(phyAddr, 0x0E, regAddr)
+	    && writePhy(phyAddr, 0x0D, 0x4000 | devAddr)
+	    && writePhy(phyAddr, 0x0E, value);
+}
+
+bool AxiMdio::execute(MdioBatch &batch)
+{
+	// A non-zero device address selects Clause 22 indirect access to that MMD
+
+	for(MdioTransaction &t : batch)
+	{
+		bool ok = false;
+
+		if(t.op == MdioTransaction::OP_READ)
+		{
+			if(t.devAddr)
+			{
+				ok = readPhyIndirect(t.phyAddr, t.devAddr, t.regAddr, t.value);
+			}
+			else
+			{
+				ok = readPhy(t.phyAddr, t.regAddr, t.value);
+			}
+		}
+		else
+		{
+			if(t.devAddr)
+			{
+				ok = writePhyIndirect(t.phyAddr, t.devAddr, t.regAddr, t.value);
+			}
+			else
+			{
+				ok = writePhy(t.phyAddr, t.regAddr, t.value);
+			}
+		}
+
+		if(!ok)
+		{
+			qWarning("[core] W: %s: MDIO transaction timed out, phy address %02X, device %02X, register %04X",
+			         qUtf8Printable(m_name), t.phyAddr, t.devAddr, t.regAddr);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void AxiMdio::submit(const MdioBatch &batch, QObject *context, const MdioCallback &callback)
+{
+	m_worker->enqueue(batch, context, callback);
+}
+
+bool AxiMdio::waitForIdle()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	while(m_regs->ctl & CTL_START)
+	{
+		if(timer.nsecsElapsed() > TIMEOUT_NS)
+		{
+			return false;
+		}
+	}
+
+	return true;
 }
 
 void AxiMdio::setReset(bool reset)
@@ -201,6 +275,8 @@ void AxiMdio::setReset(bool reset)
 
 bool AxiMdio::setProperty(PropertyID propID, const QByteArray &value)
 {
+	// PHY registers are only accessible through setPropertyAsync
+
 	Q_UNUSED(propID);
 	Q_UNUSED(value);
 	return false;
@@ -208,8 +284,172 @@ bool AxiMdio::setProperty(PropertyID propID, const QByteArray &value)
 
 bool AxiMdio::getProperty(PropertyID propID, const QByteArray &params, QByteArray &value)
 {
+	// PHY registers are only accessible through getPropertyAsync
+
 	Q_UNUSED(propID);
 	Q_UNUSED(params);
 	Q_UNUSED(value);
 	return false;
 }
+
+bool AxiMdio::isAsyncProperty(PropertyID propID) const
+{
+	switch(propID)
+	{
+		case PROP_PHY_REG:
+		case PROP_PHY_REG_BULK:
+		case PROP_PHY_DUMP:
+		{
+			return true;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+void AxiMdio::setPropertyAsync(PropertyID propID, const QByteArray &value, QObject *context, const PropertyCallback &callback)
+{
+	MdioBatch batch;
+
+	switch(propID)
+	{
+		case PROP_PHY_REG:
+		{
+			if(value.length() != 6) break;
+
+			parseRegisterList(value, MdioTransaction::OP_WRITE, batch);
+			break;
+		}
+
+		case PROP_PHY_REG_BULK:
+		{
+			parseRegisterList(value, MdioTransaction::OP_WRITE, batch);
+			break;
+		}
+
+		default:
+		{
+			break;
+		}
+	}
+
+	if(batch.isEmpty())
+	{
+		callback(false, value);
+		return;
+	}
+
+	submit(batch, context,
+		[callback, value](bool ok, const MdioBatch &batch)
+		{
+			Q_UNUSED(batch);
+			callback(ok, value);
+		}
+	);
+}
+
+void AxiMdio::getPropertyAsync(PropertyID propID, const QByteArray &params, QObject *context, const PropertyCallback &callback)
+{
+	MdioBatch batch;
+
+	switch(propID)
+	{
+		case PROP_PHY_REG:
+		{
+			if(params.length() != 4) break;
+
+			parseRegisterList(params, MdioTransaction::OP_READ, batch);
+			break;
+		}
+
+		case PROP_PHY_REG_BULK:
+		{
+			parseRegisterList(params, MdioTransaction::OP_READ, batch);
+			break;
+		}
+
+		case PROP_PHY_DUMP:
+		{
+			// All Clause 22 registers of every PHY, in a single batch
+
+			for(uint8_t phy : m_phys)
+			{
+				for(uint16_t reg = 0; reg < 32; ++reg)
+				{
+					batch.append({MdioTransaction::OP_READ, phy, 0, reg, 0});
+				}
+			}
+
+			break;
+		}
+
+		default:
+		{
+			break;
+		}
+	}
+
+	if(batch.isEmpty())
+	{
+		callback(false, QByteArray());
+		return;
+	}
+
+	QList<uint8_t> ports = m_ports;
+
+	submit(batch, context,
+		[callback, propID, ports](bool ok, const MdioBatch &batch)
+		{
+			QByteArray value;
+
+			if(ok)
+			{
+				for(int i = 0; i < batch.size(); ++i)
+				{
+					if(propID == PROP_PHY_DUMP && !(i % 32))
+					{
+						appendAsBytes<uint8_t>(value, ports[i / 32]);
+						appendAsBytes<uint8_t>(value, batch[i].phyAddr);
+					}
+
+					appendAsBytes<uint16_t>(value, batch[i].value);
+				}
+			}
+
+			callback(ok, value);
+		}
+	);
+}
+
+bool AxiMdio::parseRegisterList(const QByteArray &data, MdioTransaction::Operation op, MdioBatch &batch) const
+{
+	// Each entry contains port, MMD (0 for direct access), register and, for writes, the value
+
+	int stride = (op == MdioTransaction::OP_WRITE) ? 6 : 4;
+
+	if(data.isEmpty() || (data.length() % stride) != 0)
+	{
+		return false;
+	}
+
+	for(int i = 0; i < data.length(); i += stride)
+	{
+		int idx = m_ports.indexOf(readAsNumber<uint8_t>(data, i));
+		uint8_t devAddr = readAsNumber<uint8_t>(data, i + 1);
+		uint16_t regAddr = readAsNumber<uint16_t>(data, i + 2);
+		uint16_t value = (op == MdioTransaction::OP_WRITE) ? readAsNumber<uint16_t>(data, i + 4) : 0;
+
+		if(idx < 0 || devAddr > 31 || (!devAddr && regAddr > 31))
+		{
+			batch.clear();
+			return false;
+		}
+
+		batch.append({op, m_phys[idx], devAddr, regAddr, value});
+	}
+
+	return true;
+}
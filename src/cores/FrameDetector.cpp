@@ -19,18 +19,34 @@
 #include <cores/FrameDetector.hpp>
 
 #include <QDebug>
+#include <QtEndian>
 
 #include <AbstractDevice.hpp>
 #include <FdtUtils.hpp>
 
+using Regs = FrameDetector::Registers;
+using Desc = PropertyDescriptor;
+
+static constexpr PropertyDescriptor properties[] =
+{
+	{PROP_ENABLE,        PROPERTY_REG(Regs, config),        1, Desc::FLAG_RW,                   FrameDetector::CFG_ENABLE},
+	{PROP_ENABLE_LOG,    PROPERTY_REG(Regs, config),        1, Desc::FLAG_RW | Desc::FLAG_BOOL, FrameDetector::CFG_LOG_ENABLE},
+	{PROP_ENABLE_SCRIPT, PROPERTY_REG(Regs, script_enable), 4, Desc::FLAG_RW}
+};
+
 FrameDetector::FrameDetector(const QString &name, uint32_t id, void *regs, uint8_t portA, uint8_t portB)
-	: AbstractCore(name, id), m_regs((volatile Registers*) regs), m_portA(portA), m_portB(portB)
+	: AbstractCore(name, id), m_regs((volatile Registers*) regs), m_shadow(), m_portA(portA), m_portB(portB)
 {
-	m_regs->config = CFG_LOG_ENABLE | CFG_ENABLE;
-	m_regs->log_identifier = m_id | MSG_ID_MEASUREMENT;
+	setPropertyTable(properties, m_regs, &m_shadow);
+	syncRegisters();
+
+	m_regs->config = m_shadow.config = CFG_LOG_ENABLE | CFG_ENABLE;
+	m_regs->log_identifier = m_shadow.log_identifier = m_id | MSG_ID_MEASUREMENT;
 
-	m_scriptNames.fill("", 2 * m_regs->num_scripts);
-	m_scriptSizes.fill(0, 2 * m_regs->num_scripts);
+	m_scriptNames.fill("", 2 * m_shadow.num_scripts);
+	m_scriptSizes.fill(0, 2 * m_shadow.num_scripts);
+	m_scriptValid.fill(false, 2 * m_shadow.num_scripts);
+	m_scriptMem.fill(0, 2 * m_shadow.num_scripts * m_shadow.max_script_size);
 
 	qInfo("[core] %s is connected to ports %d and %d", qUtf8Printable(name), portA, portB);
 }
@@ -57,6 +73,8 @@ AbstractCore *FrameDetector::createCore(AbstractDevice *parent, const QString &n
 
 void FrameDetector::announce(QByteArray &output) const
 {
+	int start = output.size();
+
 	appendAsBytes<uint8_t>(output, m_id);
 	appendAsBytes<uint8_t>(output, DEV_FRAME_DETECTOR);
 	appendAsBytes<uint16_t>(output, 42);
@@ -68,20 +86,22 @@ void FrameDetector::announce(QByteArray &output) const
 
 	appendAsBytes<uint16_t>(output, PROP_FEATURE_BITS);
 	appendAsBytes<uint16_t>(output, 4);
-	appendAsBytes<uint32_t>(output, m_regs->features);
+	appendAsBytes<uint32_t>(output, m_shadow.features);
 
 	appendAsBytes<uint16_t>(output, PROP_NUM_SCRIPTS);
 	appendAsBytes<uint16_t>(output, 4);
-	appendAsBytes<uint32_t>(output, m_regs->num_scripts);
+	appendAsBytes<uint32_t>(output, m_shadow.num_scripts);
 
 	appendAsBytes<uint16_t>(output, PROP_MAX_SCRIPT_SIZE);
 	appendAsBytes<uint16_t>(output, 4);
-	appendAsBytes<uint32_t>(output, m_regs->max_script_size);
+	appendAsBytes<uint32_t>(output, m_shadow.max_script_size);
 
 	appendAsBytes<uint16_t>(output, PROP_FIFO_SIZE);
 	appendAsBytes<uint16_t>(output, 8);
-	appendAsBytes<uint32_t>(output, m_regs->tx_fifo_size);
-	appendAsBytes<uint32_t>(output, m_regs->extr_fifo_size);
+	appendAsBytes<uint32_t>(output, m_shadow.tx_fifo_size);
+	appendAsBytes<uint32_t>(output, m_shadow.extr_fifo_size);
+
+	announceProperties(output, start);
 }
 
 DeviceType FrameDetector::getType() const
@@ -98,50 +118,48 @@ void FrameDetector::setReset(bool reset)
 {
 	if(reset)
 	{
-		m_regs->config = CFG_RESET;
+		m_regs->config = m_shadow.config = CFG_RESET;
+		m_scriptValid.fill(false);
 	}
 	else
 	{
-		m_regs->config = 0;
+		m_regs->config = m_shadow.config = 0;
+		syncRegisters();
 	}
 }
 
+void FrameDetector::syncRegisters()
+{
+	m_shadow.config = m_regs->config;
+	m_shadow.log_identifier = m_regs->log_identifier;
+	m_shadow.script_enable = m_regs->script_enable;
+	m_shadow.features = m_regs->features;
+	m_shadow.num_scripts = m_regs->num_scripts;
+	m_shadow.max_script_size = m_regs->max_script_size;
+	m_shadow.script_mem_offset = m_regs->script_mem_offset;
+	m_shadow.tx_fifo_size = m_regs->tx_fifo_size;
+	m_shadow.extr_fifo_size = m_regs->extr_fifo_size;
+}
+
 bool FrameDetector::setProperty(PropertyID propID, const QByteArray &value)
 {
-	switch(propID)
-	{
-		case PROP_ENABLE:
-		{
-			if(value.length() < 1) return false;
+	const PropertyDescriptor *desc = findProperty(propID);
 
-			m_regs->config = (m_regs->config & ~CFG_ENABLE) | (readAsNumber<uint8_t>(value, 0) & CFG_ENABLE);
-			break;
-		}
+	if(desc)
+	{
+		// Only the bits of the slots present in this core can be enabled, the number of slots is
+		// read from the device so it can't be part of the table
 
-		case PROP_ENABLE_LOG:
+		if(propID == PROP_ENABLE_SCRIPT && value.length() >= 4 && 2 * m_shadow.num_scripts < 32)
 		{
-			if(value.length() < 1) return false;
-
-			if(readAsNumber<uint8_t>(value, 0))
-			{
-				m_regs->config |= CFG_LOG_ENABLE;
-			}
-			else
-			{
-				m_regs->config &= ~CFG_LOG_ENABLE;
-			}
-
-			break;
+			if(readAsNumber<uint32_t>(value, 0) >> (2 * m_shadow.num_scripts)) return false;
 		}
 
-		case PROP_ENABLE_SCRIPT:
-		{
-			if(value.length() < 4) return false;
-
-			m_regs->script_enable = readAsNumber<uint32_t>(value, 0);
-			break;
-		}
+		return writeProperty(*desc, value);
+	}
 
+	switch(propID)
+	{
 		case PROP_OVERFLOW_COUNT:
 		{
 			// read-only
@@ -156,7 +174,7 @@ bool FrameDetector::setProperty(PropertyID propID, const QByteArray &value)
 
 			uint32_t idx = readAsNumber<uint32_t>(value, 0);
 
-			if(idx >= 2*m_regs->num_scripts) return false;
+			if(idx >= 2*m_shadow.num_scripts) return false;
 
 			// Extract name
 
@@ -172,35 +190,72 @@ bool FrameDetector::setProperty(PropertyID propID, const QByteArray &value)
 
 			if(scriptLen <= 0 || (scriptLen % 4) != 0) return false;
 
-			// Disable script while it's being updated
+			// Build the new contents of the slot and compare them with the copy of what's in the device
+
+			uint32_t scriptWords = m_shadow.max_script_size;
+			uint32_t *cache = m_scriptMem.data() + idx * scriptWords;
+			QVector<uint32_t> image(scriptWords, 0);
 
-			uint32_t mask = 1 << idx;
-			uint32_t enable = m_regs->script_enable;
+			scriptLen = qMin<int>(scriptLen, 4 * scriptWords);
 
-			m_regs->script_enable = enable & ~mask;
+			for(int i = 0, j = nameLen + 5; i < scriptLen / 4; ++i, j += 4)
+			{
+				image[i] = qFromLittleEndian<uint32_t>(value.constData() + j);
+			}
 
-			// Copy new values
+			// Pairs of words are written using 64-bit stores, if the slot is aligned for them
 
-			uint32_t *ptr = makePointer<uint32_t>(m_regs, m_regs->script_mem_offset + 4 * idx * m_regs->max_script_size);
+			uint32_t memOffset = m_shadow.script_mem_offset + 4 * idx * scriptWords;
+			uint32_t step = (memOffset % 8) ? 1 : 2;
+			QVector<uint32_t> changed;
 
-			for(int i = 0, j = nameLen + 5, k = m_regs->max_script_size; i < k; ++i, j += 4)
+			for(uint32_t i = 0; i < scriptWords; i += step)
 			{
-				if(j < value.length())
+				uint32_t n = qMin(step, scriptWords - i);
+
+				if(!m_scriptValid[idx] || memcmp(cache + i, image.constData() + i, 4 * n))
 				{
-					ptr[i] = readAsNumber<uint32_t>(value, j);
+					changed.append(i);
 				}
-				else
+			}
+
+			if(changed.size())
+			{
+				// Disable script while it's being updated
+
+				uint32_t mask = 1 << idx;
+				uint32_t enable = m_shadow.script_enable;
+
+				m_regs->script_enable = enable & ~mask;
+
+				volatile uint32_t *ptr32 = makePointer<volatile uint32_t>(m_regs, memOffset);
+				volatile uint64_t *ptr64 = makePointer<volatile uint64_t>(m_regs, memOffset);
+
+				for(uint32_t i : changed)
 				{
-					ptr[i] = 0;
+					if(step == 2 && i + 1 < scriptWords)
+					{
+						uint64_t pair;
+						memcpy(&pair, image.constData() + i, 8);
+
+						ptr64[i / 2] = pair;
+					}
+					else
+					{
+						ptr32[i] = image[i];
+					}
 				}
+
+				// Resume operation
+
+				m_regs->script_enable = enable;
+
+				memcpy(cache, image.constData(), 4 * scriptWords);
+				m_scriptValid[idx] = true;
 			}
 
 			m_scriptNames[idx] = name;
 			m_scriptSizes[idx] = scriptLen;
-
-			// Resume operation
-
-			m_regs->script_enable = enable;
 			break;
 		}
 
@@ -215,26 +270,16 @@ bool FrameDetector::setProperty(PropertyID propID, const QByteArray &value)
 
 bool FrameDetector::getProperty(PropertyID propID, const QByteArray &params, QByteArray &value)
 {
-	switch(propID)
-	{
-		case PROP_ENABLE:
-		{
-			appendAsBytes<uint8_t>(value, m_regs->config & CFG_ENABLE);
-			break;
-		}
-
-		case PROP_ENABLE_LOG:
-		{
-			appendAsBytes<uint8_t>(value, !!(m_regs->config & CFG_LOG_ENABLE));
-			break;
-		}
+	const PropertyDescriptor *desc = findProperty(propID);
 
-		case PROP_ENABLE_SCRIPT:
-		{
-			appendAsBytes(value, m_regs->script_enable);
-			break;
-		}
+	if(desc)
+	{
+		readProperty(*desc, value);
+		return true;
+	}
 
+	switch(propID)
+	{
 		case PROP_OVERFLOW_COUNT:
 		{
 			appendAsBytes(value, m_regs->overflow_count_a);
@@ -247,16 +292,16 @@ bool FrameDetector::getProperty(PropertyID propID, const QByteArray &params, QBy
 			if(params.length() < 4) return false;
 
 			uint32_t idx = readAsNumber<uint32_t>(params, 0);
-			if(idx >= 2*m_regs->num_scripts) return false;
+			if(idx >= 2*m_shadow.num_scripts) return false;
 
 			value.append(m_scriptNames[idx]);
 			value.push_back('\0');
 
-			uint32_t *ptr = makePointer<uint32_t>(m_regs, m_regs->script_mem_offset + 4 * idx * m_regs->max_script_size);
+			const uint32_t *cache = m_scriptMem.constData() + idx * m_shadow.max_script_size;
 
-			for(int i = 0, j = m_scriptSizes[idx]; i < j; ++i)
+			for(int i = 0, j = m_scriptSizes[idx] / 4; i < j; ++i)
 			{
-				appendAsBytes(value, ptr[i]);
+				appendAsBytes(value, cache[i]);
 			}
 
 			break;
@@ -23,14 +23,31 @@
 #include <AbstractDevice.hpp>
 #include <FdtUtils.hpp>
 
+using Regs = LatencyMeasurer::Registers;
+using Desc = PropertyDescriptor;
+
+static constexpr PropertyDescriptor properties[] =
+{
+	{PROP_ENABLE,           PROPERTY_REG(Regs, config),         1, Desc::FLAG_RW,                   LatencyMeasurer::CFG_ENABLE},
+	{PROP_ENABLE_LOG,       PROPERTY_REG(Regs, config),         1, Desc::FLAG_RW | Desc::FLAG_BOOL, LatencyMeasurer::CFG_LOG_ENABLE},
+	{PROP_ENABLE_BROADCAST, PROPERTY_REG(Regs, config),         1, Desc::FLAG_RW | Desc::FLAG_BOOL, LatencyMeasurer::CFG_BROADCAST},
+	{PROP_FRAME_PADDING,    PROPERTY_REG(Regs, padding),        2, Desc::FLAG_RW,                   0, 0, LatencyMeasurer::MAX_PADDING},
+	{PROP_FRAME_GAP,        PROPERTY_REG(Regs, delay),          4, Desc::FLAG_RW,                   0, LatencyMeasurer::MIN_DELAY},
+	{PROP_TIMEOUT,          PROPERTY_REG(Regs, timeout),        4, Desc::FLAG_RW,                   0, 1},
+	{PROP_OVERFLOW_COUNT,   PROPERTY_REG(Regs, overflow_count), 8, Desc::FLAG_READ | Desc::FLAG_LIVE}
+};
+
 LatencyMeasurer::LatencyMeasurer(const QString &name, uint32_t id, void *regs, uint8_t portA, uint8_t portB)
-	: AbstractCore(name, id), m_regs((volatile Registers*) regs), m_portA(portA), m_portB(portB)
+	: AbstractCore(name, id), m_regs((volatile Registers*) regs), m_shadow(), m_portA(portA), m_portB(portB)
 {
-	m_regs->config = 0;
-	m_regs->padding = 18;
-	m_regs->timeout = 125000000;
-	m_regs->delay = 12500000;
-	m_regs->log_identifier = m_id | MSG_ID_MEASUREMENT;
+	setPropertyTable(properties, m_regs, &m_shadow);
+	syncRegisters();
+
+	m_regs->config = m_shadow.config = 0;
+	m_regs->padding = m_shadow.padding = 18;
+	m_regs->timeout = m_shadow.timeout = 125000000;
+	m_regs->delay = m_shadow.delay = 12500000;
+	m_regs->log_identifier = m_shadow.log_identifier = m_id | MSG_ID_MEASUREMENT;
 
 	qInfo("[core] %s is connected to ports %d and %d", qUtf8Printable(name), portA, portB);
 }
@@ -57,6 +74,8 @@ AbstractCore *LatencyMeasurer::createCore(AbstractDevice *parent, const QString
 
 void LatencyMeasurer::announce(QByteArray &output) const
 {
+	int start = output.size();
+
 	appendAsBytes<uint8_t>(output, m_id);
 	appendAsBytes<uint8_t>(output, DEV_LATENCY_MEASURER);
 	appendAsBytes<uint16_t>(output, 6);
@@ -65,6 +84,8 @@ void LatencyMeasurer::announce(QByteArray &output) const
 	appendAsBytes<uint16_t>(output, 2);
 	appendAsBytes<uint8_t>(output, m_portA);
 	appendAsBytes<uint8_t>(output, m_portB);
+
+	announceProperties(output, start);
 }
 
 DeviceType LatencyMeasurer::getType() const
@@ -81,71 +102,58 @@ void LatencyMeasurer::setReset(bool reset)
 {
 	if(reset)
 	{
-		m_regs->config = CFG_RESET;
+		m_regs->config = m_shadow.config = CFG_RESET;
 	}
 	else
 	{
-		m_regs->config = 0;
+		m_regs->config = m_shadow.config = 0;
+		syncRegisters();
 	}
 }
 
-bool LatencyMeasurer::setProperty(PropertyID propID, const QByteArray &value)
+void LatencyMeasurer::syncRegisters()
 {
-	switch(propID)
-	{
-		case PROP_ENABLE:
-		{
-			if(value.length() < 1) return false;
+	m_shadow.config = m_regs->config;
+	m_shadow.log_identifier = m_regs->log_identifier;
 
-			m_regs->config = (m_regs->config & ~CFG_ENABLE) | (readAsNumber<uint8_t>(value, 0) & CFG_ENABLE);
-			break;
-		}
-
-		case PROP_ENABLE_LOG:
-		{
-			if(value.length() < 1) return false;
-
-			if(readAsNumber<uint8_t>(value, 0))
-			{
-				m_regs->config |= CFG_LOG_ENABLE;
-			}
-			else
-			{
-				m_regs->config &= ~CFG_LOG_ENABLE;
-			}
-
-			break;
-		}
+	for(int i = 0; i < 6; ++i)
+	{
+		m_shadow.mac_addr_a[i] = m_regs->mac_addr_a[i];
+		m_shadow.mac_addr_b[i] = m_regs->mac_addr_b[i];
+	}
 
-		case PROP_ENABLE_BROADCAST:
-		{
-			if(value.length() < 1) return false;
+	m_shadow.ip_addr_a = m_regs->ip_addr_a;
+	m_shadow.ip_addr_b = m_regs->ip_addr_b;
+	m_shadow.padding = m_regs->padding;
+	m_shadow.delay = m_regs->delay;
+	m_shadow.timeout = m_regs->timeout;
+}
 
-			if(readAsNumber<uint8_t>(value, 0))
-			{
-				m_regs->config |= CFG_BROADCAST;
-			}
-			else
-			{
-				m_regs->config &= ~CFG_BROADCAST;
-			}
+bool LatencyMeasurer::setProperty(PropertyID propID, const QByteArray &value)
+{
+	const PropertyDescriptor *desc = findProperty(propID);
 
-			break;
-		}
+	if(desc)
+	{
+		return writeProperty(*desc, value);
+	}
 
+	switch(propID)
+	{
 		case PROP_MAC_ADDR:
 		{
 			if(value.length() < 7) return false;
 			if(value[0] > 1) return false;
 
-			uint16_t cfg = m_regs->config;
+			uint16_t cfg = m_shadow.config;
 			volatile uint8_t *ptr = value[0] ? m_regs->mac_addr_b : m_regs->mac_addr_a;
+			uint8_t *shadowPtr = value[0] ? m_shadow.mac_addr_b : m_shadow.mac_addr_a;
 
 			m_regs->config = cfg & ~CFG_ENABLE;
 
 			for(int i = 0, j = 1; i < 6; ++i, ++j)
 			{
-				ptr[i] = value[j];
+				ptr[i] = shadowPtr[i] = value[j];
 			}
 
 			m_regs->config = cfg;
@@ -159,46 +167,16 @@ bool LatencyMeasurer::setProperty(PropertyID propID, const QByteArray &value)
 
 			if(!value[0])
 			{
-				m_regs->ip_addr_a = readAsNumber<uint32_t>(value, 1);
+				m_regs->ip_addr_a = m_shadow.ip_addr_a = readAsNumber<uint32_t>(value, 1);
 			}
 			else
 			{
-				m_regs->ip_addr_b = readAsNumber<uint32_t>(value, 1);
+				m_regs->ip_addr_b = m_shadow.ip_addr_b = readAsNumber<uint32_t>(value, 1);
 			}
 
 			break;
 		}
 
-		case PROP_FRAME_PADDING:
-		{
-			if(value.length() < 2) return false;
-
-			m_regs->padding = readAsNumber<uint16_t>(value, 0);
-			break;
-		}
-
-		case PROP_FRAME_GAP:
-		{
-			if(value.length() < 4) return false;
-
-			m_regs->delay = readAsNumber<uint32_t>(value, 0);
-			break;
-		}
-
-		case PROP_TIMEOUT:
-		{
-			if(value.length() < 4) return false;
-
-			m_regs->timeout = readAsNumber<uint32_t>(value, 0);
-			break;
-		}
-
-		case PROP_OVERFLOW_COUNT:
-		{
-			// read-only
-			break;
-		}
-
 		default:
 		{
 			return false;
@@ -210,32 +188,22 @@ bool LatencyMeasurer::setProperty(PropertyID propID, const QByteArray &value)
 
 bool LatencyMeasurer::getProperty(PropertyID propID, const QByteArray &params, QByteArray &value)
 {
-	switch(propID)
-	{
-		case PROP_ENABLE:
-		{
-			appendAsBytes<uint8_t>(value, m_regs->config & CFG_ENABLE);
-			break;
-		}
-
-		case PROP_ENABLE_LOG:
-		{
-			appendAsBytes<uint8_t>(value, !!(m_regs->config & CFG_LOG_ENABLE));
-			break;
-		}
+	const PropertyDescriptor *desc = findProperty(propID);
 
-		case PROP_ENABLE_BROADCAST:
-		{
-			appendAsBytes<uint8_t>(value, !!(m_regs->config & CFG_BROADCAST));
-			break;
-		}
+	if(desc)
+	{
+		readProperty(*desc, value);
+		return true;
+	}
 
+	switch(propID)
+	{
 		case PROP_MAC_ADDR:
 		{
 			if(params.length() < 1) return false;
 			if(params[0] > 1) return false;
 
-			value.append((char*) (!params[0] ? m_regs->mac_addr_a : m_regs->mac_addr_b), 6);
+			value.append((const char*) (!params[0] ? m_shadow.mac_addr_a : m_shadow.mac_addr_b), 6);
 			break;
 		}
 
@@ -244,39 +212,48 @@ bool LatencyMeasurer::getProperty(PropertyID propID, const QByteArray &params, Q
 			if(params.length() < 1) return false;
 			if(params[0] > 1) return false;
 
-			appendAsBytes(value, !params[0] ? m_regs->ip_addr_a : m_regs->ip_addr_b);
+			appendAsBytes(value, !params[0] ? m_shadow.ip_addr_a : m_shadow.ip_addr_b);
 			break;
 		}
 
-		case PROP_FRAME_PADDING:
+		default:
 		{
-			appendAsBytes<uint16_t>(value, m_regs->padding);
-			break;
+			return false;
 		}
+	}
 
-		case PROP_FRAME_GAP:
-		{
-			appendAsBytes(value, m_regs->delay);
-			break;
-		}
+	return true;
+}
 
-		case PROP_TIMEOUT:
-		{
-			appendAsBytes(value, m_regs->timeout);
-			break;
-		}
+bool LatencyMeasurer::setHold(bool hold)
+{
+	if(hold)
+	{
+		m_shadow.config |= CFG_HOLD;
+	}
+	else
+	{
+		m_shadow.config &= ~CFG_HOLD;
+	}
 
-		case PROP_OVERFLOW_COUNT:
-		{
-			appendAsBytes(value, m_regs->overflow_count);
-			break;
-		}
+	m_regs->config = m_shadow.config;
+	return true;
+}
 
-		default:
-		{
-			return false;
-		}
-	}
+bool LatencyMeasurer::getSnapshot(QByteArray &output)
+{
+	Counters counters;
+	getCounters(counters);
 
+	output.append((const char*) &counters, sizeof(Counters));
 	return true;
 }
+
+void LatencyMeasurer::getCounters(Counters &out) const
+{
+	out.ping_pong_good = m_regs->ping_pong_good;
+	out.ping_latency = m_regs->ping_latency;
+	out.pong_latency = m_regs->pong_latency;
+	out.pings_lost = m_regs->pings_lost;
+	out.pongs_lost = m_regs->pongs_lost;
+}
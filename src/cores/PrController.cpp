@@ -89,7 +89,7 @@ uint32_t PrController::status() const
 	return m_regs->status;
 }
 
-bool PrController::loadBitstream(const QString &name)
+bool PrController::startLoad(const QString &name)
 {
 	int idx = m_bitstreamNames.indexOf(name);
 
@@ -99,23 +99,55 @@ bool PrController::loadBitstream(const QString &name)
 	}
 
 	m_regs->trigger = 1u << idx;
-	usleep(100000);
+	m_loadSeen = false;
+	m_loadClock.start();
+
+	return true;
+}
 
-	while(1)
+PrController::LoadState PrController::pollLoad()
+{
+	uint32_t status = m_regs->status;
+
+	if((status & TRIGGER_PENDING) || (status & 0b111) == ST_LOADING)
 	{
-		uint32_t status = m_regs->status;
+		m_loadSeen = true;
+		return LOAD_BUSY;
+	}
 
-		if(!(status & TRIGGER_PENDING) && (status & 0b111) != ST_LOADING)
-		{
-			break;
-		}
+	// The controller may take a moment to pick up the trigger, don't mistake that for a finished load
 
-		usleep(1000);
+	if(!m_loadSeen && m_loadClock.nsecsElapsed() < START_TIMEOUT)
+	{
+		return LOAD_BUSY;
 	}
 
 	m_regs->trigger = 0;
+	m_loadTime = m_loadClock.nsecsElapsed();
+
+	return ((m_regs->status & 0xFF) == ST_ACTIVE_OKAY) ? LOAD_OK : LOAD_FAILED;
+}
+
+bool PrController::loadBitstream(const QString &name)
+{
+	if(!startLoad(name))
+	{
+		return false;
+	}
+
+	LoadState state;
 
-	return ((m_regs->status & 0xFF) == ST_ACTIVE_OKAY);
+	while((state = pollLoad()) == LOAD_BUSY)
+	{
+		usleep(POLL_INTERVAL * 1000);
+	}
+
+	return state == LOAD_OK;
+}
+
+uint64_t PrController::loadTime() const
+{
+	return m_loadTime;
 }
 
 int PrController::activeBitstream() const
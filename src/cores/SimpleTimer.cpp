@@ -19,6 +19,8 @@
 #include <cores/SimpleTimer.hpp>
 
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
 
 #include <AbstractDevice.hpp>
 #include <FdtUtils.hpp>
@@ -26,7 +28,7 @@
 SimpleTimer::SimpleTimer(const QString &name, uint32_t id, void *regs)
 	: AbstractCore(name, id), m_regs((volatile Registers*) regs)
 {
-	m_regs->max_time = 125'000'000;
+	m_regs->max_time = m_maxTime = 125'000'000;
 }
 
 SimpleTimer::~SimpleTimer()
@@ -65,7 +67,7 @@ void SimpleTimer::setRunning(bool running)
 
 void SimpleTimer::setMaximumTime(uint64_t time)
 {
-	m_regs->max_time = time;
+	m_regs->max_time = m_maxTime = time;
 }
 
 void SimpleTimer::setReset(bool reset)
@@ -77,9 +79,35 @@ void SimpleTimer::setReset(bool reset)
 	else
 	{
 		m_regs->config = 0;
+		syncRegisters();
 	}
 }
 
+void SimpleTimer::pulseReset()
+{
+	// The counter clears within a few clock cycles, hold the reset until it reads back as zero
+
+	QElapsedTimer clock;
+
+	setReset(true);
+	QThread::usleep(RESET_PULSE);
+	clock.start();
+
+	while(m_regs->current_time != 0 && clock.nsecsElapsed() < RESET_TIMEOUT)
+	{
+		QThread::usleep(1);
+	}
+
+	setReset(false);
+}
+
+void SimpleTimer::syncRegisters()
+{
+	// Only the limit is cached, run state is always taken from the configuration register
+
+	m_maxTime = m_regs->max_time;
+}
+
 bool SimpleTimer::setProperty(PropertyID propID, const QByteArray &value)
 {
 	switch(propID)
@@ -115,7 +143,7 @@ bool SimpleTimer::setProperty(PropertyID propID, const QByteArray &value)
 		{
 			if(value.length() < 8) return false;
 
-			m_regs->max_time = readAsNumber<uint64_t>(value, 0);
+			m_regs->max_time = m_maxTime = readAsNumber<uint64_t>(value, 0);
 			break;
 		}
 
@@ -154,7 +182,7 @@ bool SimpleTimer::getProperty(PropertyID propID, const QByteArray &params, QByte
 
 		case PROP_TIMER_LIMIT:
 		{
-			appendAsBytes(value, m_regs->max_time);
+			appendAsBytes(value, m_maxTime);
 			break;
 		}
 
@@ -174,5 +202,5 @@ uint64_t SimpleTimer::getCurrentTime() const
 
 uint64_t SimpleTimer::getMaximumTime() const
 {
-	return m_regs->max_time;
+	return m_maxTime;
 }
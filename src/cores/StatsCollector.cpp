@@ -23,12 +23,25 @@
 #include <AbstractDevice.hpp>
 #include <FdtUtils.hpp>
 
+using Regs = StatsCollector::Registers;
+using Desc = PropertyDescriptor;
+
+static constexpr PropertyDescriptor properties[] =
+{
+	{PROP_ENABLE,         PROPERTY_REG(Regs, config),         1, Desc::FLAG_RW,                   StatsCollector::CFG_ENABLE},
+	{PROP_ENABLE_LOG,     PROPERTY_REG(Regs, config),         1, Desc::FLAG_RW | Desc::FLAG_BOOL, StatsCollector::CFG_LOG_ENABLE},
+	{PROP_SAMPLE_PERIOD,  PROPERTY_REG(Regs, sample_period),  4, Desc::FLAG_RW,                   0, StatsCollector::MIN_SAMPLE_PERIOD},
+	{PROP_OVERFLOW_COUNT, PROPERTY_REG(Regs, overflow_count), 8, Desc::FLAG_READ | Desc::FLAG_LIVE}
+};
+
 StatsCollector::StatsCollector(const QString &name, uint32_t id, void *regs, uint8_t port)
-	: AbstractCore(name, id), m_regs((volatile Registers*) regs), m_port(port)
+	: AbstractCore(name, id), m_regs((volatile Registers*) regs), m_shadow(), m_port(port)
 {
-	m_regs->config = CFG_LOG_ENABLE | CFG_ENABLE;
-	m_regs->sample_period = 12500000;
-	m_regs->log_identifier = m_id | MSG_ID_MEASUREMENT;
+	setPropertyTable(properties, m_regs, &m_shadow);
+
+	m_regs->config = m_shadow.config = CFG_LOG_ENABLE | CFG_ENABLE;
+	m_regs->sample_period = m_shadow.sample_period = 12500000;
+	m_regs->log_identifier = m_shadow.log_identifier = m_id | MSG_ID_MEASUREMENT;
 
 	qInfo("[core] %s is connected to port %d", qUtf8Printable(name), port);
 }
@@ -54,6 +67,8 @@ AbstractCore *StatsCollector::createCore(AbstractDevice *parent, const QString &
 
 void StatsCollector::announce(QByteArray &output) const
 {
+	int start = output.size();
+
 	appendAsBytes<uint8_t>(output, m_id);
 	appendAsBytes<uint8_t>(output, DEV_STATS_COLLECTOR);
 	appendAsBytes<uint16_t>(output, 5);
@@ -61,6 +76,8 @@ void StatsCollector::announce(QByteArray &output) const
 	appendAsBytes<uint16_t>(output, PROP_PORTS);
 	appendAsBytes<uint16_t>(output, 1);
 	appendAsBytes<uint8_t>(output, m_port);
+
+	announceProperties(output, start);
 }
 
 DeviceType StatsCollector::getType() const
@@ -77,100 +94,74 @@ void StatsCollector::setReset(bool reset)
 {
 	if(reset)
 	{
-		m_regs->config = CFG_RESET;
+		m_regs->config = m_shadow.config = CFG_RESET;
 	}
 	else
 	{
-		m_regs->config = 0;
+		m_regs->config = m_shadow.config = 0;
+		syncRegisters();
 	}
 }
 
+void StatsCollector::syncRegisters()
+{
+	m_shadow.config = m_regs->config;
+	m_shadow.log_identifier = m_regs->log_identifier;
+	m_shadow.sample_period = m_regs->sample_period;
+}
+
 bool StatsCollector::setProperty(PropertyID propID, const QByteArray &value)
 {
-	switch(propID)
-	{
-		case PROP_ENABLE:
-		{
-			if(value.length() < 1) return false;
-
-			m_regs->config = (m_regs->config & ~CFG_ENABLE) | (readAsNumber<uint8_t>(value, 0) & CFG_ENABLE);
-			break;
-		}
-
-		case PROP_ENABLE_LOG:
-		{
-			if(value.length() < 1) return false;
-
-			if(readAsNumber<uint8_t>(value, 0))
-			{
-				m_regs->config |= CFG_LOG_ENABLE;
-			}
-			else
-			{
-				m_regs->config &= ~CFG_LOG_ENABLE;
-			}
-
-			break;
-		}
-
-		case PROP_SAMPLE_PERIOD:
-		{
-			if(value.length() < 4) return false;
-
-			m_regs->sample_period = readAsNumber<uint32_t>(value, 0);
-			break;
-		}
-
-		case PROP_OVERFLOW_COUNT:
-		{
-			// read-only
-			break;
-		}
-
-		default:
-		{
-			return false;
-		}
-	}
+	const PropertyDescriptor *desc = findProperty(propID);
 
-	return true;
+	if(!desc) return false;
+
+	return writeProperty(*desc, value);
 }
 
 bool StatsCollector::getProperty(PropertyID propID, const QByteArray &params, QByteArray &value)
 {
 	Q_UNUSED(params);
 
-	switch(propID)
+	const PropertyDescriptor *desc = findProperty(propID);
+
+	if(!desc) return false;
+
+	readProperty(*desc, value);
+	return true;
+}
+
+bool StatsCollector::setHold(bool hold)
+{
+	if(hold)
 	{
-		case PROP_ENABLE:
-		{
-			appendAsBytes<uint8_t>(value, m_regs->config & CFG_ENABLE);
-			break;
-		}
-
-		case PROP_ENABLE_LOG:
-		{
-			appendAsBytes<uint8_t>(value, !!(m_regs->config & CFG_LOG_ENABLE));
-			break;
-		}
-
-		case PROP_SAMPLE_PERIOD:
-		{
-			appendAsBytes(value, m_regs->sample_period);
-			break;
-		}
-
-		case PROP_OVERFLOW_COUNT:
-		{
-			appendAsBytes(value, m_regs->overflow_count);
-			break;
-		}
-
-		default:
-		{
-			return false;
-		}
+		m_shadow.config |= CFG_HOLD;
+	}
+	else
+	{
+		m_shadow.config &= ~CFG_HOLD;
 	}
 
+	m_regs->config = m_shadow.config;
 	return true;
 }
+
+bool StatsCollector::getSnapshot(QByteArray &output)
+{
+	Counters counters;
+	getCounters(counters);
+
+	output.append((const char*) &counters, sizeof(Counters));
+	return true;
+}
+
+void StatsCollector::getCounters(Counters &out) const
+{
+	out.time = m_regs->time;
+	out.tx_bytes = m_regs->tx_bytes;
+	out.tx_good = m_regs->tx_good;
+	out.tx_bad = m_regs->tx_bad;
+	out.rx_bytes = m_regs->rx_bytes;
+	out.rx_good = m_regs->rx_good;
+	out.rx_bad = m_regs->rx_bad;
+}
@@ -18,21 +18,41 @@
 
 #include <cores/TrafficGenerator.hpp>
 
+#include <atomic>
+
 #include <QDebug>
+#include <QElapsedTimer>
 
 #include <AbstractDevice.hpp>
 #include <FdtUtils.hpp>
 
-TrafficGenerator::TrafficGenerator(const QString &name, uint32_t id, void *regs, uint8_t port)
-	: AbstractCore(name, id), m_regs((volatile Registers*) regs), m_port(port)
+using Regs = TrafficGenerator::Registers;
+using Desc = PropertyDescriptor;
+
+static constexpr PropertyDescriptor properties[] =
 {
-	m_regs->fsize = 60;
-	m_regs->fdelay = 12;
-	m_regs->burst_time_on = 100;
-	m_regs->burst_time_off = 100;
+	{PROP_ENABLE,         PROPERTY_REG(Regs, config),         1, Desc::FLAG_RW,                   TrafficGenerator::CFG_ENABLE},
+	{PROP_ENABLE_BURST,   PROPERTY_REG(Regs, config),         1, Desc::FLAG_RW | Desc::FLAG_BOOL, TrafficGenerator::CFG_BURST},
+	{PROP_FRAME_SIZE,     PROPERTY_REG(Regs, fsize),          2, Desc::FLAG_RW,                   0, TrafficGenerator::MIN_FRAME_SIZE, TrafficGenerator::MAX_FRAME_SIZE},
+	{PROP_FRAME_GAP,      PROPERTY_REG(Regs, fdelay),         4, Desc::FLAG_RW,                   0, TrafficGenerator::MIN_FRAME_GAP},
+	{PROP_BURST_TIME_ON,  PROPERTY_REG(Regs, burst_time_on),  2, Desc::FLAG_RW,                   0, 1},
+	{PROP_BURST_TIME_OFF, PROPERTY_REG(Regs, burst_time_off), 2, Desc::FLAG_RW}
+};
+
+TrafficGenerator::TrafficGenerator(const QString &name, uint32_t id, void *regs, void *wcRegs, uint8_t port)
+	: AbstractCore(name, id), m_regs((volatile Registers*) regs), m_shadow(), m_wcRegs(wcRegs), m_port(port)
+{
+	setPropertyTable(properties, m_regs, &m_shadow);
+	syncRegisters();
+
+	m_regs->fsize = m_shadow.fsize = 60;
+	m_regs->fdelay = m_shadow.fdelay = 12;
+	m_regs->burst_time_on = m_shadow.burst_time_on = 100;
+	m_regs->burst_time_off = m_shadow.burst_time_off = 100;
 
 	m_templateName = "";
 	m_templateSize = 0;
+	m_templateMem.fill(0x00, 2 * TGEN_MEM_SIZE);
 
 	qInfo("[core] %s is connected to port %d", qUtf8Printable(name), port);
 }
@@ -43,8 +63,6 @@ TrafficGenerator::~TrafficGenerator()
 AbstractCore *TrafficGenerator::createCore(AbstractDevice *parent, const QString &name, uint32_t id,
                                            void *regs, const void *fdt, int offset)
 {
-	Q_UNUSED(parent);
-
 	uint8_t port = 0;
 
 	if(!fdtGetArrayProp(fdt, offset, "zbnt,ports", port))
@@ -53,11 +71,15 @@ AbstractCore *TrafficGenerator::createCore(AbstractDevice *parent, const QString
 		return nullptr;
 	}
 
-	return new TrafficGenerator(name, id, regs, port);
+	void *wcRegs = parent->writeCombiningAlias(regs, TGEN_MEM_SOURCE_OFFSET + TGEN_MEM_SIZE);
+
+	return new TrafficGenerator(name, id, regs, wcRegs, port);
 }
 
 void TrafficGenerator::announce(QByteArray &output) const
 {
+	int start = output.size();
+
 	appendAsBytes<uint8_t>(output, m_id);
 	appendAsBytes<uint8_t>(output, DEV_TRAFFIC_GENERATOR);
 	appendAsBytes<uint16_t>(output, 13);
@@ -69,6 +91,8 @@ void TrafficGenerator::announce(QByteArray &output) const
 	appendAsBytes<uint16_t>(output, PROP_MAX_TEMPLATE_SIZE);
 	appendAsBytes<uint16_t>(output, 4);
 	appendAsBytes<uint32_t>(output, TGEN_MEM_SIZE);
+
+	announceProperties(output, start);
 }
 
 DeviceType TrafficGenerator::getType() const
@@ -85,80 +109,45 @@ void TrafficGenerator::setReset(bool reset)
 {
 	if(reset)
 	{
-		m_regs->config = CFG_RESET;
+		m_regs->config = m_shadow.config = CFG_RESET;
+		m_templateValid = false;
 	}
 	else
 	{
-		m_regs->config = 0;
+		m_regs->config = m_shadow.config = 0;
+		syncRegisters();
 	}
 }
 
-bool TrafficGenerator::setProperty(PropertyID propID, const QByteArray &value)
+void TrafficGenerator::syncRegisters()
 {
-	switch(propID)
-	{
-		case PROP_ENABLE:
-		{
-			if(value.length() < 1) return false;
-
-			m_regs->config = (m_regs->config & ~CFG_ENABLE) | (readAsNumber<uint8_t>(value, 0) & CFG_ENABLE);
-			break;
-		}
-
-		case PROP_ENABLE_BURST:
-		{
-			if(value.length() < 1) return false;
-
-			if(readAsNumber<uint8_t>(value, 0))
-			{
-				m_regs->config |= CFG_BURST;
-			}
-			else
-			{
-				m_regs->config &= ~CFG_BURST;
-			}
-
-			break;
-		}
-
-		case PROP_FRAME_SIZE:
-		{
-			if(value.length() < 2) return false;
-
-			m_regs->fsize = readAsNumber<uint16_t>(value, 0);
-			break;
-		}
-
-		case PROP_FRAME_GAP:
-		{
-			if(value.length() < 4) return false;
-
-			m_regs->fdelay = readAsNumber<uint32_t>(value, 0);
-			break;
-		}
-
-		case PROP_BURST_TIME_ON:
-		{
-			if(value.length() < 2) return false;
-
-			m_regs->burst_time_on = readAsNumber<uint16_t>(value, 0);
-			break;
-		}
+	m_shadow.config = m_regs->config & ~CFG_SEED_REQ;
+	m_shadow.fsize = m_regs->fsize;
+	m_shadow.fdelay = m_regs->fdelay;
+	m_shadow.burst_time_on = m_regs->burst_time_on;
+	m_shadow.burst_time_off = m_regs->burst_time_off;
+	m_shadow.prng_seed_val = m_regs->prng_seed_val;
+}
 
-		case PROP_BURST_TIME_OFF:
-		{
-			if(value.length() < 2) return false;
+bool TrafficGenerator::setProperty(PropertyID propID, const QByteArray &value)
+{
+	const PropertyDescriptor *desc = findProperty(propID);
 
-			m_regs->burst_time_off = readAsNumber<uint16_t>(value, 0);
-			break;
-		}
+	if(desc)
+	{
+		return writeProperty(*desc, value);
+	}
 
+	switch(propID)
+	{
 		case PROP_PRNG_SEED:
 		{
 			if(value.length() < 1) return false;
 
-			m_regs->prng_seed_val = readAsNumber<uint8_t>(value, 0);
-			m_regs->config |= CFG_SEED_REQ;
+			// CFG_SEED_REQ is a request strobe, it's never kept in the shadow copy
+
+			m_regs->prng_seed_val = m_shadow.prng_seed_val = readAsNumber<uint8_t>(value, 0);
+			m_regs->config = m_shadow.config | CFG_SEED_REQ;
 			break;
 		}
 
@@ -179,40 +168,72 @@ bool TrafficGenerator::setProperty(PropertyID propID, const QByteArray &value)
 
 			if(dataLen == 0 || (dataLen % 2) != 0) return false;
 
-			// Disable transmission while we update the template
+			// Build the new contents of both memories, they're contiguous in the address space
+
+			const char *srcA = value.constData() + nameLen + 1;
+			const char *srcB = srcA + templateLen;
 
-			uint32_t config = m_regs->config;
+			templateLen = qMin(templateLen, TGEN_MEM_SIZE);
 
-			m_regs->config = config & ~CFG_ENABLE;
+			QByteArray image(2 * TGEN_MEM_SIZE, 0x00);
+			memset(image.data() + TGEN_MEM_SIZE, 0x01, TGEN_MEM_SIZE);
+			memcpy(image.data(), srcA, templateLen);
+			memcpy(image.data() + TGEN_MEM_SIZE, srcB, templateLen);
 
-			// Copy new values
+			// Find the 64-bit words that differ from the current template
 
-			const char *srcA = value.constData() + nameLen + 1;
-			const char *srcB = srcA + templateLen;
+			QVector<int> changed;
+
+			for(int i = 0; i < 2 * TGEN_MEM_SIZE; i += 8)
+			{
+				if(!m_templateValid || memcmp(m_templateMem.constData() + i, image.constData() + i, 8))
+				{
+					changed.append(i);
+				}
+			}
 
-			uint8_t *dstA = makePointer<uint8_t>(m_regs, TGEN_MEM_TEMPLATE_OFFSET);
-			uint8_t *dstB = makePointer<uint8_t>(m_regs, TGEN_MEM_SOURCE_OFFSET);
+			QElapsedTimer uploadTimer;
+			uploadTimer.start();
 
-			for(int i = 0; i < TGEN_MEM_SIZE; ++i)
+			if(changed.size())
 			{
-				if(i < templateLen)
+				// Disable transmission while we update the template
+
+				uint32_t config = m_shadow.config;
+
+				m_regs->config = config & ~CFG_ENABLE;
+
+				// Copy new values, through the write-combining mapping if available
+
+				void *mem = m_wcRegs ? m_wcRegs : (void*) m_regs;
+				volatile uint64_t *dst = makePointer<volatile uint64_t>(mem, TGEN_MEM_TEMPLATE_OFFSET);
+
+				for(int i : changed)
 				{
-					dstA[i] = srcA[i];
-					dstB[i] = srcB[i];
+					uint64_t word;
+					memcpy(&word, image.constData() + i, 8);
+
+					dst[i / 8] = word;
 				}
-				else
+
+				if(m_wcRegs)
 				{
-					dstA[i] = 0x00;
-					dstB[i] = 0x01;
+					std::atomic_thread_fence(std::memory_order_seq_cst);
 				}
+
+				// Resume operation
+
+				m_regs->config = config;
+
+				m_templateMem = image;
+				m_templateValid = true;
 			}
 
+			m_uploadTime = uploadTimer.nsecsElapsed();
+			m_uploadBytes = 8 * changed.size();
+
 			m_templateName = name;
 			m_templateSize = templateLen;
-
-			// Resume operation
-
-			m_regs->config = config;
 			break;
 		}
 
@@ -229,47 +250,19 @@ bool TrafficGenerator::getProperty(PropertyID propID, const QByteArray &params,
 {
 	Q_UNUSED(params);
 
-	switch(propID)
-	{
-		case PROP_ENABLE:
-		{
-			appendAsBytes<uint8_t>(value, m_regs->config & CFG_ENABLE);
-			break;
-		}
-
-		case PROP_ENABLE_BURST:
-		{
-			appendAsBytes<uint8_t>(value, !!(m_regs->config & CFG_BURST));
-			break;
-		}
-
-		case PROP_FRAME_SIZE:
-		{
-			appendAsBytes<uint16_t>(value, m_regs->fsize);
-			break;
-		}
-
-		case PROP_FRAME_GAP:
-		{
-			appendAsBytes(value, m_regs->fdelay);
-			break;
-		}
+	const PropertyDescriptor *desc = findProperty(propID);
 
-		case PROP_BURST_TIME_ON:
-		{
-			appendAsBytes(value, m_regs->burst_time_on);
-			break;
-		}
-
-		case PROP_BURST_TIME_OFF:
-		{
-			appendAsBytes(value, m_regs->burst_time_off);
-			break;
-		}
+	if(desc)
+	{
+		readProperty(*desc, value);
+		return true;
+	}
 
+	switch(propID)
+	{
 		case PROP_PRNG_SEED:
 		{
-			appendAsBytes(value, m_regs->prng_seed_val);
+			appendAsBytes(value, m_shadow.prng_seed_val);
 			break;
 		}
 
@@ -282,15 +275,18 @@ bool TrafficGenerator::getProperty(PropertyID propID, const QByteArray &params,
 
 			// Data bytes
 
-			char *srcA = makePointer<char>(m_regs, TGEN_MEM_TEMPLATE_OFFSET);
-
-			value.append(srcA, m_templateSize);
+			value.append(m_templateMem.constData(), m_templateSize);
 
 			// Source selectors
 
-			char *srcB = makePointer<char>(m_regs, TGEN_MEM_SOURCE_OFFSET);
+			value.append(m_templateMem.constData() + TGEN_MEM_SIZE, m_templateSize);
+			break;
+		}
 
-			value.append(srcB, m_templateSize);
+		case PROP_UPLOAD_STATS:
+		{
+			appendAsBytes(value, m_uploadTime);
+			appendAsBytes(value, m_uploadBytes);
 			break;
 		}
 
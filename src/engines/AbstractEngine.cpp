@@ -0,0 +1,113 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <engines/AbstractEngine.hpp>
+
+#include <AbstractDevice.hpp>
+#include <FdtUtils.hpp>
+#include <ZbntServer.hpp>
+
+AbstractEngine::AbstractEngine(ZbntServer *server)
+	: QObject(server), m_server(server)
+{ }
+
+AbstractEngine::~AbstractEngine()
+{ }
+
+bool AbstractEngine::isActive() const
+{
+	return m_server->m_engine == this;
+}
+
+AbstractDevice *AbstractEngine::device() const
+{
+	return m_server->m_device;
+}
+
+AbstractCore *AbstractEngine::findCore(uint8_t devID) const
+{
+	return m_server->findCore(devID);
+}
+
+bool AbstractEngine::parseProperties(const QByteArray &data, int &offset, QByteArray &list)
+{
+	// u16 size, followed by (u8 core, u16 property, u16 length, value) entries
+
+	if(offset + 2 > data.length()) return false;
+
+	uint16_t size = readAsNumber<uint16_t>(data, offset);
+
+	if(offset + 2 + size > data.length()) return false;
+
+	list = data.mid(offset + 2, size);
+	offset += 2 + size;
+
+	for(int i = 0; i < list.length();)
+	{
+		if(i + 5 > list.length()) return false;
+
+		i += 5 + readAsNumber<uint16_t>(list, i + 3);
+	}
+
+	return true;
+}
+
+bool AbstractEngine::applyProperties(const QByteArray &list)
+{
+	bool ok = true;
+
+	for(int i = 0; i + 5 <= list.length();)
+	{
+		uint8_t devID = list[i];
+		PropertyID propID = PropertyID(readAsNumber<uint16_t>(list, i + 1));
+		uint16_t length = readAsNumber<uint16_t>(list, i + 3);
+		AbstractCore *core = findCore(devID);
+
+		if(!core || core->isAsyncProperty(propID) || !core->setProperty(propID, list.mid(i + 5, length)))
+		{
+			qWarning("[engine] W: Failed to set property %d of core %d", propID, devID);
+			ok = false;
+		}
+
+		i += 5 + length;
+	}
+
+	return ok;
+}
+
+void AbstractEngine::startRun(uint64_t duration, bool stream)
+{
+	SimpleTimer *timer = device()->timer();
+
+	m_server->startRun(stream);
+	timer->setMaximumTime(duration);
+	timer->setRunning(true);
+}
+
+void AbstractEngine::sendMessage(MessageID id, const QByteArray &data)
+{
+	if(m_server->clientAvailable())
+	{
+		m_server->sendMessage(id, data);
+	}
+}
+
+void AbstractEngine::finish()
+{
+	m_server->onEngineFinished(this, true);
+}
@@ -0,0 +1,277 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <engines/Rfc2544.hpp>
+
+#include <QDebug>
+#include <QTimer>
+
+#include <FdtUtils.hpp>
+#include <cores/TrafficGenerator.hpp>
+
+Rfc2544::Rfc2544(ZbntServer *server)
+	: AbstractEngine(server)
+{ }
+
+Rfc2544::~Rfc2544()
+{ }
+
+bool Rfc2544::load(const QByteArray &data)
+{
+	// u64 trial duration in timer cycles, u32 tolerated loss in parts per million,
+	// u32 minimum gap, u32 maximum gap, u32 resolution, u8 number of port pairs,
+	// (u8 generator, u8 tx stats collector, u8 rx stats collector) for each pair,
+	// u8 number of frame sizes and u16 for each of them
+
+	if(data.length() < 25) return false;
+
+	m_trialDuration = readAsNumber<uint64_t>(data, 0);
+	m_tolerance = readAsNumber<uint32_t>(data, 8);
+	m_minGap = readAsNumber<uint32_t>(data, 12);
+	m_maxGap = readAsNumber<uint32_t>(data, 16);
+	m_resolution = qMax<uint32_t>(readAsNumber<uint32_t>(data, 20), 1);
+
+	if(!m_trialDuration || m_minGap > m_maxGap) return false;
+	if(m_minGap < TrafficGenerator::MIN_FRAME_GAP) return false;
+
+	int offset = 24;
+	int pairCount = readAsNumber<uint8_t>(data, offset++);
+
+	if(!pairCount || offset + 3 * pairCount + 1 > data.length()) return false;
+
+	for(int i = 0; i < pairCount; ++i, offset += 3)
+	{
+		AbstractCore *generator = findCore(data[offset]);
+		AbstractCore *txStats = findCore(data[offset + 1]);
+		AbstractCore *rxStats = findCore(data[offset + 2]);
+
+		if(!generator || generator->getType() != DEV_TRAFFIC_GENERATOR) return false;
+		if(!txStats || txStats->getType() != DEV_STATS_COLLECTOR) return false;
+		if(!rxStats || rxStats->getType() != DEV_STATS_COLLECTOR) return false;
+
+		m_pairs.append({generator, (StatsCollector*) txStats, (StatsCollector*) rxStats, {}, {}});
+	}
+
+	int sizeCount = readAsNumber<uint8_t>(data, offset++);
+
+	if(!sizeCount || offset + 2 * sizeCount > data.length()) return false;
+
+	for(int i = 0; i < sizeCount; ++i, offset += 2)
+	{
+		uint16_t frameSize = readAsNumber<uint16_t>(data, offset);
+
+		if(frameSize < TrafficGenerator::MIN_FRAME_SIZE || frameSize > TrafficGenerator::MAX_FRAME_SIZE) return false;
+
+		m_frameSizes.append(frameSize);
+	}
+
+	return true;
+}
+
+AbstractEngine::EngineType Rfc2544::getType() const
+{
+	return ENGINE_RFC2544;
+}
+
+void Rfc2544::start()
+{
+	qInfo("[engine] I: Starting RFC 2544 search for %d frame sizes", m_frameSizes.size());
+
+	m_sizeIdx = 0;
+	startSize();
+}
+
+void Rfc2544::onRunStopped()
+{
+	// Give frames still in flight time to arrive before reading the counters
+
+	setGenerators(false);
+	QTimer::singleShot(DRAIN_TIME, this, [this]() { evaluateTrial(); });
+}
+
+void Rfc2544::startSize()
+{
+	m_results.append({m_frameSizes[m_sizeIdx], false, 0, 0, 0});
+
+	m_stage = STAGE_MIN_GAP;
+	m_lo = m_minGap;
+	m_hi = m_maxGap;
+
+	startTrial(m_minGap);
+}
+
+void Rfc2544::startTrial(uint32_t gap)
+{
+	QByteArray frameSize, frameGap;
+
+	appendAsBytes<uint16_t>(frameSize, m_frameSizes[m_sizeIdx]);
+	appendAsBytes<uint32_t>(frameGap, gap);
+
+	m_gap = gap;
+
+	for(PortPair &pair : m_pairs)
+	{
+		pair.generator->setProperty(PROP_FRAME_SIZE, frameSize);
+		pair.generator->setProperty(PROP_FRAME_GAP, frameGap);
+
+		pair.txStats->getCounters(pair.txStart);
+		pair.rxStats->getCounters(pair.rxStart);
+	}
+
+	// Only the trial results are reported, the measurements of each trial stay on the server
+
+	setGenerators(true);
+	startRun(m_trialDuration, false);
+}
+
+void Rfc2544::evaluateTrial()
+{
+	if(!isActive()) return;
+
+	// Trial result: u16 frame size, u32 gap, u8 passed, then u64 tx frames and u64 rx frames for each pair
+
+	QByteArray message;
+	uint64_t txTotal = 0, rxTotal = 0;
+	bool passed = true;
+
+	appendAsBytes<uint16_t>(message, m_frameSizes[m_sizeIdx]);
+	appendAsBytes<uint32_t>(message, m_gap);
+	appendAsBytes<uint8_t>(message, 0);
+
+	for(PortPair &pair : m_pairs)
+	{
+		StatsCollector::Counters txEnd, rxEnd;
+
+		pair.txStats->getCounters(txEnd);
+		pair.rxStats->getCounters(rxEnd);
+
+		uint64_t tx = txEnd.tx_good - pair.txStart.tx_good;
+		uint64_t rx = rxEnd.rx_good - pair.rxStart.rx_good;
+		uint64_t lost = (tx > rx) ? tx - rx : 0;
+
+		if(!tx || lost * 1'000'000 > uint64_t(m_tolerance) * tx)
+		{
+			passed = false;
+		}
+
+		appendAsBytes<uint64_t>(message, tx);
+		appendAsBytes<uint64_t>(message, rx);
+
+		txTotal += tx;
+		rxTotal += rx;
+	}
+
+	message[6] = passed;
+	sendMessage(MSG_ID_RFC2544_TRIAL, message);
+
+	Result &result = m_results.last();
+
+	if(passed)
+	{
+		result = {m_frameSizes[m_sizeIdx], true, m_gap, txTotal, rxTotal};
+	}
+
+	// Try the highest rate first, then the lowest one, then bisect between the last failure and the last success
+
+	switch(m_stage)
+	{
+		case STAGE_MIN_GAP:
+		{
+			if(passed || m_minGap == m_maxGap)
+			{
+				finishSize();
+				return;
+			}
+
+			m_stage = STAGE_MAX_GAP;
+			startTrial(m_maxGap);
+			return;
+		}
+
+		case STAGE_MAX_GAP:
+		{
+			if(!passed)
+			{
+				finishSize();
+				return;
+			}
+
+			m_stage = STAGE_SEARCH;
+			break;
+		}
+
+		case STAGE_SEARCH:
+		{
+			if(passed)
+			{
+				m_hi = m_gap;
+			}
+			else
+			{
+				m_lo = m_gap;
+			}
+
+			break;
+		}
+	}
+
+	if(m_hi - m_lo <= m_resolution)
+	{
+		finishSize();
+		return;
+	}
+
+	startTrial(m_lo + (m_hi - m_lo) / 2);
+}
+
+void Rfc2544::finishSize()
+{
+	if(++m_sizeIdx < m_frameSizes.size())
+	{
+		startSize();
+		return;
+	}
+
+	// Final table: u8 count, then u16 frame size, u8 found, u32 gap, u64 tx frames and u64 rx frames for each size
+
+	QByteArray message;
+	appendAsBytes<uint8_t>(message, m_results.size());
+
+	for(const Result &result : m_results)
+	{
+		appendAsBytes<uint16_t>(message, result.frameSize);
+		appendAsBytes<uint8_t>(message, result.found);
+		appendAsBytes<uint32_t>(message, result.gap);
+		appendAsBytes<uint64_t>(message, result.txFrames);
+		appendAsBytes<uint64_t>(message, result.rxFrames);
+	}
+
+	sendMessage(MSG_ID_RFC2544_RESULT, message);
+	finish();
+}
+
+void Rfc2544::setGenerators(bool enable)
+{
+	QByteArray value;
+	appendAsBytes<uint8_t>(value, enable);
+
+	for(PortPair &pair : m_pairs)
+	{
+		pair.generator->setProperty(PROP_ENABLE, value);
+	}
+}
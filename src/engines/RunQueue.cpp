@@ -0,0 +1,95 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <engines/RunQueue.hpp>
+
+#include <QDebug>
+
+#include <FdtUtils.hpp>
+
+RunQueue::RunQueue(ZbntServer *server)
+	: AbstractEngine(server)
+{ }
+
+RunQueue::~RunQueue()
+{ }
+
+bool RunQueue::load(const QByteArray &data)
+{
+	// u16 count, then for each run: u64 duration in timer cycles and a property list
+
+	if(data.length() < 2) return false;
+
+	uint16_t count = readAsNumber<uint16_t>(data, 0);
+	int offset = 2;
+
+	for(int i = 0; i < count; ++i)
+	{
+		Run run;
+
+		if(offset + 8 > data.length()) return false;
+
+		run.duration = readAsNumber<uint64_t>(data, offset);
+		offset += 8;
+
+		if(!run.duration) return false;
+		if(!parseProperties(data, offset, run.properties)) return false;
+
+		m_runs.append(run);
+	}
+
+	return m_runs.size();
+}
+
+AbstractEngine::EngineType RunQueue::getType() const
+{
+	return ENGINE_RUN_QUEUE;
+}
+
+void RunQueue::start()
+{
+	qInfo("[engine] I: Starting run queue with %d runs", m_runs.size());
+
+	m_index = -1;
+	startNext();
+}
+
+void RunQueue::onRunStopped()
+{
+	startNext();
+}
+
+void RunQueue::startNext()
+{
+	if(++m_index >= m_runs.size())
+	{
+		finish();
+		return;
+	}
+
+	// Announce the entry before its RUN_START, so clients can tell which run the data belongs to
+
+	const Run &run = m_runs[m_index];
+	QByteArray message;
+
+	appendAsBytes<uint16_t>(message, m_index);
+	appendAsBytes<uint8_t>(message, applyProperties(run.properties));
+
+	sendMessage(MSG_ID_RUN_QUEUE_ITEM, message);
+	startRun(run.duration);
+}
@@ -0,0 +1,294 @@
+/*
+	zbnt/server
+	Copyright (C) 2020 Oscar R.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <engines/Sweep.hpp>
+
+#include <QDebug>
+
+#include <AbstractDevice.hpp>
+#include <FdtUtils.hpp>
+
+Sweep::Sweep(ZbntServer *server)
+	: AbstractEngine(server)
+{
+	m_sampleTimer = new QTimer(this);
+	m_sampleTimer->setInterval(SAMPLE_INTERVAL);
+	m_sampleTimer->setSingleShot(false);
+
+	connect(m_sampleTimer, &QTimer::timeout, this, &Sweep::sampleLatency);
+}
+
+Sweep::~Sweep()
+{ }
+
+bool Sweep::load(const QByteArray &data)
+{
+	// u64 dwell time in timer cycles, u8 mode, then the description of the points
+
+	if(data.length() < 9) return false;
+
+	m_dwellTime = readAsNumber<uint64_t>(data, 0);
+
+	if(!m_dwellTime) return false;
+
+	switch(readAsNumber<uint8_t>(data, 8))
+	{
+		case MODE_CARTESIAN:
+		{
+			if(!loadCartesian(data, 9)) return false;
+			break;
+		}
+
+		case MODE_LIST:
+		{
+			if(!loadList(data, 9)) return false;
+			break;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+
+	// Results are collected from every latency measurer and stats collector
+
+	for(AbstractCore *core : device()->coreList())
+	{
+		if(core->getType() == DEV_LATENCY_MEASURER)
+		{
+			m_latency.append({(LatencyMeasurer*) core, {}, 0, {}, {}, {}, 0});
+		}
+		else if(core->getType() == DEV_STATS_COLLECTOR)
+		{
+			m_traffic.append({(StatsCollector*) core, {}});
+		}
+	}
+
+	return m_points.size();
+}
+
+bool Sweep::loadCartesian(const QByteArray &data, int offset)
+{
+	// u8 number of axes, then u8 core, u16 property, u8 value width, u16 value count and the values for each axis
+
+	struct Axis
+	{
+		QByteArray header;
+		QVector<QByteArray> values;
+	};
+
+	if(offset + 1 > data.length()) return false;
+
+	int axisCount = readAsNumber<uint8_t>(data, offset++);
+	QVector<Axis> axes;
+	int total = 1;
+
+	for(int i = 0; i < axisCount; ++i)
+	{
+		if(offset + 6 > data.length()) return false;
+
+		Axis axis;
+		uint8_t width = readAsNumber<uint8_t>(data, offset + 3);
+		uint16_t count = readAsNumber<uint16_t>(data, offset + 4);
+
+		if(!width || !count) return false;
+		if(offset + 6 + width * count > data.length()) return false;
+
+		// Checked before multiplying, the product of two counts can overflow an int
+
+		if(count > MAX_POINTS / total) return false;
+
+		axis.header = data.mid(offset, 3);
+		appendAsBytes<uint16_t>(axis.header, width);
+
+		for(int j = 0; j < count; ++j)
+		{
+			axis.values.append(data.mid(offset + 6 + j * width, width));
+		}
+
+		total *= count;
+		offset += 6 + width * count;
+
+		axes.append(axis);
+	}
+
+	if(axes.isEmpty()) return false;
+
+	// The first axis changes slowest
+
+	for(int p = 0; p < total; ++p)
+	{
+		QByteArray point;
+		int rem = p;
+
+		for(int i = axes.size() - 1; i >= 0; --i)
+		{
+			const Axis &axis = axes[i];
+			QByteArray entry = axis.header + axis.values[rem % axis.values.size()];
+
+			point.prepend(entry);
+			rem /= axis.values.size();
+		}
+
+		m_points.append(point);
+	}
+
+	return true;
+}
+
+bool Sweep::loadList(const QByteArray &data, int offset)
+{
+	// u16 number of points, then a property list for each of them
+
+	if(offset + 2 > data.length()) return false;
+
+	uint16_t count = readAsNumber<uint16_t>(data, offset);
+	offset += 2;
+
+	for(int i = 0; i < count; ++i)
+	{
+		QByteArray point;
+
+		if(!parseProperties(data, offset, point)) return false;
+
+		m_points.append(point);
+	}
+
+	return true;
+}
+
+AbstractEngine::EngineType Sweep::getType() const
+{
+	return ENGINE_SWEEP;
+}
+
+void Sweep::start()
+{
+	qInfo("[engine] I: Starting sweep with %d points", m_points.size());
+
+	m_index = 0;
+	startPoint();
+}
+
+void Sweep::startPoint()
+{
+	m_applied = applyProperties(m_points[m_index]);
+
+	for(LatencyStats &stats : m_latency)
+	{
+		stats.core->getCounters(stats.start);
+		stats.lastCount = stats.start.ping_pong_good;
+		stats.min[0] = stats.min[1] = UINT32_MAX;
+		stats.max[0] = stats.max[1] = 0;
+		stats.sum[0] = stats.sum[1] = 0;
+		stats.samples = 0;
+	}
+
+	for(TrafficStats &stats : m_traffic)
+	{
+		stats.core->getCounters(stats.start);
+	}
+
+	startRun(m_dwellTime);
+	m_sampleTimer->start();
+}
+
+void Sweep::sampleLatency()
+{
+	// Latency registers hold the last measurement, only take them after a new ping-pong completes
+
+	for(LatencyStats &stats : m_latency)
+	{
+		LatencyMeasurer::Counters counters;
+		stats.core->getCounters(counters);
+
+		if(counters.ping_pong_good == stats.lastCount) continue;
+
+		uint32_t latency[2] = {counters.ping_latency, counters.pong_latency};
+
+		for(int i = 0; i < 2; ++i)
+		{
+			stats.min[i] = qMin(stats.min[i], latency[i]);
+			stats.max[i] = qMax(stats.max[i], latency[i]);
+			stats.sum[i] += latency[i];
+		}
+
+		stats.lastCount = counters.ping_pong_good;
+		stats.samples++;
+	}
+}
+
+void Sweep::onRunStopped()
+{
+	m_sampleTimer->stop();
+
+	// Point summary: u16 index, u8 properties applied, u8 number of cores, then for each core its index, type and:
+	//  - stats collector: tx bytes, tx good, tx bad, rx bytes, rx good, rx bad (u64)
+	//  - latency measurer: ping-pongs, pings lost, pongs lost (u64), ping and pong latency min, max, average (u32)
+
+	QByteArray message;
+
+	appendAsBytes<uint16_t>(message, m_index);
+	appendAsBytes<uint8_t>(message, m_applied);
+	appendAsBytes<uint8_t>(message, m_traffic.size() + m_latency.size());
+
+	for(const TrafficStats &stats : m_traffic)
+	{
+		StatsCollector::Counters end;
+		stats.core->getCounters(end);
+
+		appendAsBytes<uint8_t>(message, stats.core->getIndex());
+		appendAsBytes<uint8_t>(message, DEV_STATS_COLLECTOR);
+		appendAsBytes<uint64_t>(message, end.tx_bytes - stats.start.tx_bytes);
+		appendAsBytes<uint64_t>(message, end.tx_good - stats.start.tx_good);
+		appendAsBytes<uint64_t>(message, end.tx_bad - stats.start.tx_bad);
+		appendAsBytes<uint64_t>(message, end.rx_bytes - stats.start.rx_bytes);
+		appendAsBytes<uint64_t>(message, end.rx_good - stats.start.rx_good);
+		appendAsBytes<uint64_t>(message, end.rx_bad - stats.start.rx_bad);
+	}
+
+	for(const LatencyStats &stats : m_latency)
+	{
+		LatencyMeasurer::Counters end;
+		stats.core->getCounters(end);
+
+		appendAsBytes<uint8_t>(message, stats.core->getIndex());
+		appendAsBytes<uint8_t>(message, DEV_LATENCY_MEASURER);
+		appendAsBytes<uint64_t>(message, end.ping_pong_good - stats.start.ping_pong_good);
+		appendAsBytes<uint64_t>(message, end.pings_lost - stats.start.pings_lost);
+		appendAsBytes<uint64_t>(message, end.pongs_lost - stats.start.pongs_lost);
+
+		for(int i = 0; i < 2; ++i)
+		{
+			appendAsBytes<uint32_t>(message, stats.samples ? stats.min[i] : 0);
+			appendAsBytes<uint32_t>(message, stats.max[i]);
+			appendAsBytes<uint32_t>(message, stats.samples ? stats.sum[i] / stats.samples : 0);
+		}
+	}
+
+	sendMessage(MSG_ID_SWEEP_POINT, message);
+
+	if(++m_index >= m_points.size())
+	{
+		finish();
+		return;
+	}
+
+	startPoint();
+}